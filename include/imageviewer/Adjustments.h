@@ -0,0 +1,64 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_ADJUSTMENTS_H_
+#define IMAGEVIEWER_ADJUSTMENTS_H_
+
+#include <imageviewer/ShaderProgram.h>
+#include <string>
+
+namespace imageviewer {
+
+// Non-destructive exposure, levels, gamma and tone mapping. They are applied
+// in linear light by the fragment shader, after resampling and before the
+// conversion to display values, so changing them only costs a redraw.
+class Adjustments {
+  public:
+    Adjustments();
+
+    // Exposure in stops (each stop doubles the linear value)
+    void change_exposure(double stops);
+
+    // Black and white point, in linear light
+    void change_black_point(double change);
+    void change_white_point(double change);
+
+    void change_gamma(double change);
+
+    // Compress values that the exposure pushes above white, instead of
+    // clipping them
+    void toggle_tone_mapping();
+
+    void reset();
+
+    bool is_identity() const;
+
+    // Sets the uniforms used by adjust_color() in the shader
+    void apply(const ShaderProgram& shader) const;
+
+    std::string get_description() const;
+
+  private:
+    double exposure_;
+    double black_;
+    double white_;
+    double gamma_;
+    bool tone_mapping_;
+};
+
+} // namespace imageviewer
+
+#endif
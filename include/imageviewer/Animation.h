@@ -0,0 +1,99 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_ANIMATION_H_
+#define IMAGEVIEWER_ANIMATION_H_
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <imageviewer/FrameDecoder.h>
+#include <imageviewer/Image.h>
+#include <imageviewer/Texture.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace imageviewer {
+
+// Plays an animated image. Frames are decoded on a worker thread into a
+// small queue and uploaded ahead of time into a ring of textures, so memory
+// use does not depend on the number of frames.
+class Animation {
+  public:
+    // Returns nullptr if the file is not an animated GIF or PNG
+    static std::unique_ptr<Animation> open(const std::string& filename);
+
+    explicit Animation(std::unique_ptr<FrameDecoder> decoder);
+    ~Animation();
+
+    // No copying or moving (the decoder thread refers to this)
+    Animation(const Animation&) = delete;
+    Animation& operator=(const Animation&) = delete;
+
+    // Advances playback by time_delta seconds, at the frames' own delays
+    void update(double time_delta);
+
+    // Seconds until update should be called again, or a negative value if
+    // playback has stopped
+    double get_time_to_next_frame() const;
+
+    bool has_frame() const { return ring_count_ > 0; }
+
+    // Texture with the current frame (requires has_frame)
+    Texture& get_texture() { return ring_[ring_head_]; }
+
+    int get_width() const { return width_; }
+    int get_height() const { return height_; }
+
+  private:
+    static const int QUEUE_FRAMES = 4;
+    static const int RING_TEXTURES = 3;
+
+    struct Frame {
+        Image image;
+        int delay_ms;
+    };
+
+    void decode_frames();
+    Image take_free_image();
+    void upload_frames();
+
+    std::unique_ptr<FrameDecoder> decoder_;
+    int width_;
+    int height_;
+
+    // Shared with the decoder thread
+    mutable std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::deque<Frame> queue_;
+    std::vector<Image> free_images_;
+    bool stop_;
+    bool finished_;
+
+    std::array<Texture, RING_TEXTURES> ring_;
+    std::array<int, RING_TEXTURES> delays_ms_;
+    int ring_head_;
+    int ring_count_;
+    double elapsed_;
+    std::thread thread_;
+};
+
+} // namespace imageviewer
+
+#endif
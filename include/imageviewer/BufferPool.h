@@ -0,0 +1,100 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_BUFFER_POOL_H_
+#define IMAGEVIEWER_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <sys/resource.h>
+#include <vector>
+
+namespace imageviewer {
+
+// Reusable memory for decoded images and other large buffers. Large blocks
+// are mapped directly (backed by huge pages where possible) in a limited
+// number of size classes, and are kept for reuse when released instead of
+// being returned to the system. Loading images of similar size one after
+// another then reuses the same pages, without page faults or zeroing.
+// The image decoders allocate through this, so the decoded data can be
+// uploaded to textures straight from the pool. Thread safe.
+class BufferPool {
+  public:
+    explicit BufferPool(size_t cache_limit);
+    ~BufferPool();
+
+    // No copying
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Pool used by the image decoders
+    static BufferPool& shared();
+
+    // Like malloc, realloc and free (returns nullptr on failure)
+    void* allocate(size_t size);
+    void* reallocate(void* data, size_t size);
+    void release(void* data);
+
+    // Logs how the pool has been used and the page faults since the last
+    // report, after the given step (like "Loaded image")
+    void report(const char* step);
+
+  private:
+    struct Block;
+
+    Block* take_block(size_t size);
+    void unmap_block(Block* block);
+
+    const size_t cache_limit_;
+    std::mutex mutex_;
+    // Released blocks by mapped size
+    std::multimap<size_t, Block*> free_blocks_;
+    size_t cached_bytes_;
+    size_t mapped_bytes_;
+    size_t huge_page_bytes_;
+    size_t mappings_;
+    size_t reused_;
+    struct rusage last_usage_;
+};
+
+// Memory from the shared pool, released when destroyed
+class PooledBuffer {
+  public:
+    explicit PooledBuffer(size_t size);
+    ~PooledBuffer();
+
+    // No copying
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    // Allow moving
+    PooledBuffer(PooledBuffer&& other);
+    PooledBuffer& operator=(PooledBuffer&& other);
+
+    unsigned char* get_data() { return data_; }
+    const unsigned char* get_data() const { return data_; }
+
+    size_t get_size() const { return size_; }
+
+  private:
+    unsigned char* data_;
+    size_t size_;
+};
+
+} // namespace imageviewer
+
+#endif
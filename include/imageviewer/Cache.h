@@ -0,0 +1,45 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_CACHE_H_
+#define IMAGEVIEWER_CACHE_H_
+
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace imageviewer {
+
+// Files that are kept between runs (encoded textures, program binaries and
+// directory indexes) are stored in $XDG_CACHE_HOME/imageviewer or
+// ~/.cache/imageviewer
+
+// The cache directory, or empty if neither variable is set
+std::string get_cache_dir();
+
+// Cache file name for a key (a hash of it, with the given extension), or
+// empty if there is no cache directory
+std::string get_cache_file_name(const std::string& key,
+                                const std::string& extension);
+
+// Writes a cache file through a temporary file that is then renamed, so
+// readers never see partial data. Returns false if writing failed.
+bool write_cache_file(const std::string& cache_file,
+                      const std::function<void(std::ostream&)>& write);
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_COLOR_PROFILE_H_
+#define IMAGEVIEWER_COLOR_PROFILE_H_
+
+#include <cstddef>
+#include <glm/mat3x3.hpp>
+#include <string>
+#include <vector>
+
+namespace imageviewer {
+
+// Tone response curve of a single channel, mapping encoded values to linear
+// light (both in the range 0 to 1)
+class ToneCurve {
+  public:
+    ToneCurve() : type_{Type::PARAMETRIC}, params_{1.0} {}
+
+    static ToneCurve gamma(double gamma);
+    static ToneCurve parametric(const std::vector<double>& params);
+    static ToneCurve table(const std::vector<double>& values);
+
+    double to_linear(double value) const;
+
+    // Inverts the (monotonic) curve, numerically unless it is parametric
+    double from_linear(double value) const;
+
+  private:
+    enum class Type { PARAMETRIC, TABLE };
+
+    Type type_;
+    // Parameters g, a, b, c, d, e, f (as in ICC parametricCurveType 4)
+    std::vector<double> params_;
+    std::vector<double> table_;
+};
+
+// RGB color profile based on primaries (matrix) and tone curves
+class ColorProfile {
+  public:
+    ColorProfile();
+
+    // Parses an ICC matrix/TRC profile. Throws if it can't be used.
+    static ColorProfile from_icc(const std::vector<unsigned char>& icc);
+
+    static ColorProfile from_icc_file(const std::string& filename);
+
+    const ToneCurve& get_curve(int channel) const { return curves_[channel]; }
+
+    // Linear RGB to CIE XYZ (D50, as the ICC profile connection space)
+    const glm::dmat3& get_to_xyz() const { return to_xyz_; }
+
+    const std::string& get_name() const { return name_; }
+
+  private:
+    std::string name_;
+    ToneCurve curves_[3];
+    glm::dmat3 to_xyz_;
+};
+
+// Extracts an embedded ICC profile from PNG or JPEG file data. Returns an
+// empty vector if there is none.
+std::vector<unsigned char> extract_icc_profile(const unsigned char* data,
+                                               size_t size);
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_COLOR_TRANSFORM_H_
+#define IMAGEVIEWER_COLOR_TRANSFORM_H_
+
+#include <imageviewer/glfw.h>
+
+#include <imageviewer/ColorProfile.h>
+#include <imageviewer/ShaderProgram.h>
+
+namespace imageviewer {
+
+// Color management baked into lookup tables for the fragment shader: a 1D
+// LUT from 8-bit source values to linear light (one texel fetch per channel
+// and tap), a gamut matrix from source to display primaries and a 1D LUT
+// from linear light to display values (applied once per fragment).
+class ColorTransform {
+  public:
+    ColorTransform() : input_lut_{0}, output_lut_{0} {}
+    ColorTransform(const ColorProfile& source, const ColorProfile& display);
+    ~ColorTransform();
+
+    // No copying
+    ColorTransform(const ColorTransform&) = delete;
+    ColorTransform& operator=(const ColorTransform&) = delete;
+
+    // Allow moving
+    ColorTransform(ColorTransform&& other);
+    ColorTransform& operator=(ColorTransform&& other);
+
+    // Binds the LUTs to the given texture units and sets the uniforms
+    void apply(const ShaderProgram& shader, GLint input_unit,
+               GLint output_unit);
+
+  private:
+    GLuint input_lut_;
+    GLuint output_lut_;
+    glm::mat3 gamut_transform_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_COMPARE_VIEW_H_
+#define IMAGEVIEWER_COMPARE_VIEW_H_
+
+#include <imageviewer/glfw.h>
+
+#include <glm/vec2.hpp>
+#include <imageviewer/Image.h>
+#include <imageviewer/ShaderProgram.h>
+#include <imageviewer/SquareVertexArray.h>
+#include <imageviewer/TextureArray.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace imageviewer {
+
+enum class CompareLayout { SPLIT = 0, GRID = 1, FLIP = 2 };
+
+// Several images side by side with a shared camera. All images are drawn in
+// a single instanced draw call from a texture array, one cell per instance.
+class CompareView {
+  public:
+    static const size_t MAX_IMAGES = 8;
+
+    // Generated sources for the filter shader code (FilterKernels)
+    explicit CompareView(const GeneratedSources& generated);
+
+    // Rebuilds the shader, keeping the current one if that fails
+    void reload_shader(const GeneratedSources& generated);
+
+    // The first image is the reference for the difference mode
+    void add_image(std::shared_ptr<const Image> image);
+
+    size_t get_image_count() const { return images_.size(); }
+
+    // Number of cells (columns and rows) used by the current layout
+    glm::ivec2 get_grid() const;
+
+    void next_layout();
+
+    // Show the next image (in the flip layout)
+    void next_image();
+
+    void toggle_difference();
+
+    // Uploads the images if needed and binds the shader and textures. The
+    // caller then sets the common filter uniforms before calling draw().
+    const ShaderProgram& use(glm::dvec2 image_size);
+
+    void draw(SquareVertexArray& square);
+
+    std::string get_description() const;
+
+  private:
+    std::vector<std::shared_ptr<const Image>> images_;
+    TextureArray texture_array_;
+    ShaderProgram shader_;
+    CompareLayout layout_;
+    size_t flip_index_;
+    bool difference_;
+};
+
+} // namespace imageviewer
+
+#endif
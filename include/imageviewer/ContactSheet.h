@@ -0,0 +1,102 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_CONTACT_SHEET_H_
+#define IMAGEVIEWER_CONTACT_SHEET_H_
+
+#include <imageviewer/glfw.h>
+
+#include <glm/vec2.hpp>
+#include <imageviewer/Image.h>
+#include <imageviewer/MetadataIndex.h>
+#include <imageviewer/ShaderProgram.h>
+#include <imageviewer/SquareVertexArray.h>
+#include <imageviewer/TextureArray.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace imageviewer {
+
+// Thumbnails of the images in a directory, in a scrolling grid. The layout
+// comes from the metadata index, so it is known before any image has been
+// decoded. Thumbnails are made on the thread pool for the visible rows
+// (and a screen above and below), kept in the layers of one texture array
+// and all drawn with a single instanced draw call. Layers of thumbnails that
+// have scrolled away are reused, least recently seen first.
+class ContactSheet {
+  public:
+    ContactSheet(const std::string& directory, GLFWwindow* window);
+    ~ContactSheet();
+
+    // No copying
+    ContactSheet(const ContactSheet&) = delete;
+    ContactSheet& operator=(const ContactSheet&) = delete;
+
+    void render();
+
+    // Seconds until the next frame should be rendered, or a negative value
+    // if nothing changes until the next event
+    double get_time_to_next_frame() const;
+
+    void set_size(int width, int height);
+
+    void key_event(int key, int action);
+
+    void scroll_event(double offset);
+
+    void mouse_button_event(int button, int action, glm::dvec2 pos);
+
+    // Path of the image chosen with Enter (or by clicking the selected
+    // thumbnail) since the last call, or an empty string
+    std::string take_chosen();
+
+  private:
+    struct Thumbnails;
+
+    int get_columns() const;
+    // Starts tasks for the images in [first, last), then for the rest of
+    // [prefetch_first, prefetch_last)
+    void request_thumbnails(int first, int last, int prefetch_first,
+                            int prefetch_last);
+    void upload_thumbnails();
+    void select(int index);
+    void update_window_title();
+
+    GLFWwindow* window_;
+    std::vector<ImageInfo> images_;
+    std::string directory_;
+    // Per image: its layer, or NOT_LOADED, LOADING or FAILED
+    std::vector<int> layers_;
+    // Per layer: the image in it (or -1) and the frame it was last drawn
+    std::vector<int> layer_images_;
+    std::vector<long long> layer_frames_;
+    long long frame_;
+    // Shared with the thumbnail tasks, which may outlive a frame
+    std::shared_ptr<Thumbnails> thumbnails_;
+    TextureArray texture_array_;
+    GLuint cells_;
+    ShaderProgram shader_;
+    SquareVertexArray square_;
+    glm::dvec2 window_size_;
+    double scroll_;
+    int selected_;
+    std::string chosen_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_DETAIL_VIEW_H_
+#define IMAGEVIEWER_DETAIL_VIEW_H_
+
+#include <future>
+#include <glm/vec2.hpp>
+#include <imageviewer/Image.h>
+#include <imageviewer/Texture.h>
+#include <imageviewer/TiledImage.h>
+#include <memory>
+
+namespace imageviewer {
+
+// The visible region of a TiledImage at full resolution. Regions are
+// decoded in the background when the view moves and are drawn on top of
+// the low resolution preview, which shows until they are ready.
+class DetailView {
+  public:
+    explicit DetailView(std::unique_ptr<TiledImage> image);
+    ~DetailView();
+
+    // No copying
+    DetailView(const DetailView&) = delete;
+    DetailView& operator=(const DetailView&) = delete;
+
+    const TiledImage& get_image() const { return *image_; }
+
+    // Asks for the pixels from min to max (exclusive) to be available.
+    // Decoding starts unless they already are, or are being decoded.
+    void request(glm::ivec2 min, glm::ivec2 max);
+
+    // Uploads a decoded region, if one is ready
+    void update();
+
+    // Releases the texture, for when the preview is good enough
+    void clear();
+
+    bool is_decoding() const { return decoding_.valid(); }
+
+    bool has_texture() const { return texture_.is_valid(); }
+
+    Texture& get_texture() { return texture_; }
+
+    // Region covered by the texture (exclusive max)
+    glm::ivec2 get_min() const { return min_; }
+    glm::ivec2 get_max() const { return max_; }
+
+  private:
+    void start_decoding(glm::ivec2 min, glm::ivec2 max);
+
+    std::unique_ptr<TiledImage> image_;
+    Texture texture_;
+    glm::ivec2 min_;
+    glm::ivec2 max_;
+    // Region being decoded and the result (valid once decoding_ is ready)
+    std::future<void> decoding_;
+    glm::ivec2 decoding_min_;
+    glm::ivec2 decoding_max_;
+    std::unique_ptr<Image> decoded_;
+    // Latest request, started when the current decoding is done
+    glm::ivec2 wanted_min_;
+    glm::ivec2 wanted_max_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_FILE_WATCHER_H_
+#define IMAGEVIEWER_FILE_WATCHER_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace imageviewer {
+
+// Watches a file for changes with inotify, on a thread of its own. The
+// directory is watched rather than the file, so that files that are replaced
+// (written elsewhere and renamed) are noticed too. Bursts of changes are
+// debounced into a single notification, once the file has been left alone
+// for a moment.
+class FileWatcher {
+  public:
+    // on_change is called from the watcher thread after each change. A
+    // filename ending with / watches all files in that directory.
+    FileWatcher(const std::string& filename, std::function<void()> on_change);
+    ~FileWatcher();
+
+    // No copying
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // True (once) if the file has changed since the last call
+    bool take_change() { return changed_.exchange(false); }
+
+  private:
+    void run();
+    // Reads the pending events. Returns 0 if none was about the file, 1 if
+    // it is being written and 2 if it was closed or moved into place.
+    int read_events();
+
+    std::string name_;
+    std::function<void()> on_change_;
+    int inotify_fd_;
+    int stop_fd_;
+    std::atomic<bool> changed_;
+    std::thread thread_;
+};
+
+} // namespace imageviewer
+
+#endif
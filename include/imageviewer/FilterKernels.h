@@ -0,0 +1,84 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_FILTER_KERNELS_H_
+#define IMAGEVIEWER_FILTER_KERNELS_H_
+
+#include <imageviewer/glfw.h>
+
+#include <imageviewer/ShaderProgram.h>
+#include <string>
+#include <vector>
+
+namespace imageviewer {
+
+// Resampling kernels declared in a text file (shaders/kernels.txt), in
+// addition to the built-in filters. Each line declares a kernel:
+//
+//   name cubic support B C      Mitchell-Netravali cubic (support 2)
+//   name lanczos support        Lanczos (sinc windowed by sinc)
+//   name kaiser support beta    Kaiser windowed sinc
+//   name table support w0 ...   weights at evenly spaced x from 0 to support
+//   name glsl support expr...   GLSL expression of x (0 <= x < support)
+//
+// GLSL kernels are compiled into the shader as they are. The others are
+// sampled into rows of a lookup table, which the generated shader code
+// interpolates.
+class FilterKernels {
+  public:
+    FilterKernels() : lut_{0} {}
+    // Throws std::runtime_error for files that can not be read or parsed
+    explicit FilterKernels(const std::string& filename);
+    ~FilterKernels();
+
+    // No copying
+    FilterKernels(const FilterKernels&) = delete;
+    FilterKernels& operator=(const FilterKernels&) = delete;
+
+    // Allow moving
+    FilterKernels(FilterKernels&& other);
+    FilterKernels& operator=(FilterKernels&& other);
+
+    int get_count() const { return static_cast<int>(kernels_.size()); }
+
+    const std::string& get_name(int kernel) const {
+        return kernels_[kernel].name;
+    }
+
+    // Source of "kernels.glsl", defining kernel_width(kernel) and
+    // kernel_weight(kernel, x) for the kernels (and nothing else if there
+    // are none)
+    GeneratedSources get_shader_sources() const;
+
+    // Binds the lookup table to the given texture unit (if the shader uses
+    // it)
+    void apply(const ShaderProgram& shader, GLint unit) const;
+
+  private:
+    struct Kernel {
+        std::string name;
+        double support;
+        std::string expression; // For GLSL kernels
+        int lut_row;            // For the others
+    };
+
+    std::vector<Kernel> kernels_;
+    GLuint lut_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef IMAGEVIEWER_FILTER_SELECTOR_H_
+#define IMAGEVIEWER_FILTER_SELECTOR_H_
+
+#include <imageviewer/glfw.h>
+
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace imageviewer {
+
+enum class FilterType {
+    AUTO = 0,
+    BOX = 1,
+    TENT = 2,
+    GAUSSIAN = 3,
+    LANCZOS = 4
+};
+
+// Sigma of the Gaussian whose frequency response at half the sampling
+// frequency is the perceptual target (in perceived brightness)
+double get_gaussian_sigma(double perceptual_target);
+
+// A built-in filter with the parameters that the shader takes
+struct FilterChoice {
+    FilterType type = FilterType::BOX;
+    // Lobes of Lanczos, or the half width of the Gaussian in sigmas
+    double support = 0.0;
+    double gaussian_sigma = 0.0;
+
+    // Half width in texels, when not reducing
+    double get_width() const;
+    std::string get_name() const;
+
+    bool operator==(const FilterChoice& other) const {
+        return type == other.type && support == other.support &&
+               gaussian_sigma == other.gaussian_sigma;
+    }
+};
+
+// Picks the filter for the Auto setting, by scale, content and cost.
+// Enlargements get a Gaussian, tuned sharper for images with many edges,
+// and reductions get Lanczos (2 lobes for images with few edges, where 3
+// look the same). When drawing with it is predicted to take longer than the
+// frame time budget, the support is narrowed or a cheaper filter is taken.
+// The cost model is measured on the device while drawing, with timer
+// queries where the driver has them: GPU time per output pixel and filter
+// tap, for each type of filter. Choices are logged when they change.
+class FilterSelector {
+  public:
+    FilterSelector();
+    ~FilterSelector();
+
+    // No copying
+    FilterSelector(const FilterSelector&) = delete;
+    FilterSelector& operator=(const FilterSelector&) = delete;
+
+    // GPU time for drawing the image (default 8 ms)
+    void set_budget(double milliseconds) { budget_ = milliseconds; }
+
+    // The filter for drawing an image with the given edge density (see
+    // ImageStatistics) at a texel scale, covering this many output pixels.
+    // Without output pixels (for exports), the best filter is taken
+    // whatever it costs.
+    FilterChoice choose(double texel_scale, double edge_density,
+                        double pixels);
+
+    // Times the drawing between these calls, which was done with the filter
+    void begin_timing();
+    void end_timing(const FilterChoice& filter, double texel_scale,
+                    double pixels);
+
+  private:
+    struct Timing {
+        GLuint query;
+        FilterType type;
+        // Output pixels times filter taps
+        double work;
+    };
+
+    // Predicted GPU time in ms
+    double predict(const FilterChoice& filter, double texel_scale,
+                   double pixels) const;
+    // Adds the finished timings to the cost model
+    void collect();
+
+    double budget_;
+    bool timer_queries_;
+    bool timing_;
+    std::vector<GLuint> queries_;
+    std::deque<Timing> pending_;
+    // Measured ns per output pixel and filter tap, by filter type, and the
+    // number of measurements
+    std::array<double, 5> costs_;
+    std::array<int, 5> samples_;
+    FilterChoice chosen_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_FRAME_DECODER_H_
+#define IMAGEVIEWER_FRAME_DECODER_H_
+
+#include <imageviewer/Image.h>
+#include <memory>
+#include <vector>
+
+namespace imageviewer {
+
+// Decodes the frames of an animated image one at a time, so that only the
+// frames in flight need to be kept in memory
+class FrameDecoder {
+  public:
+    virtual ~FrameDecoder() = default;
+
+    // Size of the canvas that all frames are composited onto
+    virtual int get_width() const = 0;
+    virtual int get_height() const = 0;
+
+    // Decodes the next frame into frame (which has the canvas size) and its
+    // display time in milliseconds. Returns false after the last frame.
+    virtual bool next_frame(Image& frame, int& delay_ms) = 0;
+
+    // Starts over from the first frame
+    virtual void rewind() = 0;
+};
+
+// Returns a decoder for animated GIF or PNG (APNG) files, or nullptr if the
+// file only contains a single frame
+std::unique_ptr<FrameDecoder>
+open_frame_decoder(std::vector<unsigned char> file);
+
+// Returns nullptr unless file is a GIF with more than one frame. The
+// decoder takes over the file data.
+std::unique_ptr<FrameDecoder>
+open_gif_decoder(std::vector<unsigned char>& file);
+
+// Returns nullptr unless file is a PNG with an animation control chunk and
+// more than one frame. The decoder takes over the file data.
+std::unique_ptr<FrameDecoder>
+open_apng_decoder(std::vector<unsigned char>& file);
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_FRAMEBUFFER_H_
+#define IMAGEVIEWER_FRAMEBUFFER_H_
+
+#include <imageviewer/glfw.h>
+
+#include <vector>
+
+namespace imageviewer {
+
+// Offscreen render target with an RGBA8 color renderbuffer
+class Framebuffer {
+  public:
+    Framebuffer() : framebuffer_{0}, renderbuffer_{0}, width_{0}, height_{0} {}
+    Framebuffer(int width, int height);
+    ~Framebuffer();
+
+    // No copying
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    // Allow moving
+    Framebuffer(Framebuffer&& other);
+    Framebuffer& operator=(Framebuffer&& other);
+
+    // Bind for drawing and set the viewport to cover the whole framebuffer
+    void bind();
+
+    // Bind the default (window) framebuffer again
+    static void unbind();
+
+    // Read back the contents as tightly packed RGB rows, top row first
+    std::vector<unsigned char> read_pixels();
+
+    int get_width() const { return width_; }
+    int get_height() const { return height_; }
+
+  private:
+    GLuint framebuffer_;
+    GLuint renderbuffer_;
+    int width_;
+    int height_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,59 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_GIF_FRAMES_H_
+#define IMAGEVIEWER_GIF_FRAMES_H_
+
+#include <cstddef>
+#include <memory>
+
+namespace imageviewer {
+
+// Frame by frame access to the GIF decoder of stb_image (which is built in
+// Image.cpp). stbi_load_gif_from_memory would decode all frames at once.
+class GifFrames {
+  public:
+    // The data must outlive this
+    GifFrames(const unsigned char* data, size_t size);
+    ~GifFrames();
+
+    // No copying
+    GifFrames(const GifFrames&) = delete;
+    GifFrames& operator=(const GifFrames&) = delete;
+
+    // Decodes the next frame as RGBA, composited onto the earlier frames.
+    // two_back is the frame before the previous one (for disposal method 3)
+    // or nullptr. Returns nullptr after the last frame and throws if the
+    // data is corrupt. The frame is valid until the next call.
+    const unsigned char* next_frame(const unsigned char* two_back,
+                                    int& delay_ms);
+
+    // Starts over from the first frame
+    void rewind();
+
+  private:
+    struct State;
+
+    void free_buffers();
+
+    const unsigned char* data_;
+    size_t size_;
+    std::unique_ptr<State> state_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_GOLDEN_TEST_H_
+#define IMAGEVIEWER_GOLDEN_TEST_H_
+
+#include <imageviewer/glfw.h>
+
+#include <string>
+
+namespace imageviewer {
+
+// Renders checkerboard.png and synthetic test patterns offscreen at fixed
+// scales and filters, and compares the output with the golden images in
+// golden_dir. With update set, the golden images are (re)written instead.
+// Returns the number of failed comparisons.
+int run_golden_tests(GLFWwindow* window, const std::string& golden_dir,
+                     bool update);
+
+} // namespace imageviewer
+
+#endif
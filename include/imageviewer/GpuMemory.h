@@ -0,0 +1,100 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef IMAGEVIEWER_GPU_MEMORY_H_
+#define IMAGEVIEWER_GPU_MEMORY_H_
+
+#include <imageviewer/glfw.h>
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
+namespace imageviewer {
+
+// Accounts for the textures the viewer allocates, against a budget of GPU
+// memory. Textures that can be made again when needed (the copy of the image
+// that is not being drawn, the thumbnails of a contact sheet that is not
+// shown, full resolution regions that are zoomed out of) are evictable, and
+// are released least recently drawn first when a new texture would not fit
+// in the budget, or when the driver runs out of memory. Textures drawn in
+// the current frame are never released. GL thread only.
+class GpuMemory {
+  public:
+    GpuMemory();
+
+    // No copying
+    GpuMemory(const GpuMemory&) = delete;
+    GpuMemory& operator=(const GpuMemory&) = delete;
+
+    // Accounting for all textures
+    static GpuMemory& shared();
+
+    // The default is 3/4 of the dedicated video memory, if the driver tells
+    // how much there is, and otherwise 2 GB
+    void set_budget(size_t bytes);
+    size_t get_budget() const { return budget_; }
+
+    // Runs a call that allocates storage for the bound texture, making room
+    // for it first, and again if the driver runs out of memory. Throws
+    // GlOutOfMemory if it does not fit.
+    void allocate(size_t bytes, const std::function<void()>& make_storage);
+
+    // Adds and removes textures with their size
+    void add(GLuint texture, size_t bytes);
+    void remove(GLuint texture);
+
+    // Makes a texture evictable: the release function deletes it and marks
+    // its owner, which makes it again when it is needed. An empty function
+    // makes it unevictable again.
+    void set_release(GLuint texture, std::function<void()> release);
+
+    // Marks a texture as drawn in this frame
+    void touch(GLuint texture);
+
+    void next_frame() { frame_++; }
+
+    // Counts an image shown at a lower resolution than it has, since it did
+    // not fit
+    void count_reduced() { reduced_++; }
+
+    // Logs the memory in use and how much has been evicted, after the given
+    // step (like "Evicted"), and with each texture if detailed
+    void report(const char* step, bool detailed = false) const;
+
+  private:
+    struct Allocation {
+        size_t bytes;
+        long long last_frame;
+        std::function<void()> release;
+    };
+
+    // Releases the least recently drawn evictable texture that has not been
+    // drawn in the current frame, if there is one
+    bool evict_one();
+
+    std::unordered_map<GLuint, Allocation> allocations_;
+    size_t budget_;
+    size_t resident_bytes_;
+    size_t peak_bytes_;
+    long long frame_;
+    size_t evictions_;
+    size_t evicted_bytes_;
+    size_t reduced_;
+};
+
+} // namespace imageviewer
+
+#endif
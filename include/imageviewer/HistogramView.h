@@ -0,0 +1,52 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_HISTOGRAM_VIEW_H_
+#define IMAGEVIEWER_HISTOGRAM_VIEW_H_
+
+#include <imageviewer/glfw.h>
+
+#include <glm/vec2.hpp>
+#include <imageviewer/ImageStatistics.h>
+#include <imageviewer/ShaderProgram.h>
+#include <imageviewer/SquareVertexArray.h>
+
+namespace imageviewer {
+
+// Overlay in the lower left corner of the window with the red, green and
+// blue histograms drawn on top of each other
+class HistogramView {
+  public:
+    HistogramView();
+    ~HistogramView();
+
+    // No copying
+    HistogramView(const HistogramView&) = delete;
+    HistogramView& operator=(const HistogramView&) = delete;
+
+    // Uploads new histograms, scaled to the tallest bin that is not clipped
+    void update(const ImageStatistics::Result& result);
+
+    void draw(SquareVertexArray& square, glm::dvec2 window_size);
+
+  private:
+    GLuint texture_;
+    ShaderProgram shader_;
+};
+
+} // namespace imageviewer
+
+#endif
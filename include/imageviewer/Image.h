@@ -17,29 +17,52 @@
 #ifndef IMAGEVIEWER_IMAGE_H_
 #define IMAGEVIEWER_IMAGE_H_
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 namespace imageviewer {
 
 class Image {
   public:
     Image(const std::string& filename);
+    // Decodes an image file that is already in memory
+    Image(const unsigned char* data, size_t size);
+    Image(int width, int height);
     ~Image();
 
     // No copying
     Image(const Image&) = delete;
     Image& operator=(const Image&) = delete;
 
+    // Allow moving
+    Image(Image&& other);
+    Image& operator=(Image&& other);
+
     const unsigned char* get_data() const { return data_; }
 
+    unsigned char* get_data() { return data_; }
+
     int get_width() const { return width_; }
 
     int get_height() const { return height_; }
 
+    // Embedded ICC profile, or empty if there is none
+    const std::vector<unsigned char>& get_icc_profile() const {
+        return icc_profile_;
+    }
+
+    // EXIF orientation tag (1 - 8), 1 if there is none
+    int get_exif_orientation() const { return exif_orientation_; }
+
   private:
+    void decode(const unsigned char* data, size_t size);
+
     int width_;
     int height_;
     unsigned char* data_;
+    std::vector<unsigned char> icc_profile_;
+    int exif_orientation_;
 };
 
 } // namespace imageviewer
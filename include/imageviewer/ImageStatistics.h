@@ -0,0 +1,92 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_IMAGE_STATISTICS_H_
+#define IMAGEVIEWER_IMAGE_STATISTICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <imageviewer/Image.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace imageviewer {
+
+// Per-channel histograms and clipping of an image, computed in the
+// background in bands of rows on the shared thread pool. Partial results
+// can be read while the remaining bands are counted.
+class ImageStatistics {
+  public:
+    static const int BINS = 256;
+
+    struct Result {
+        std::array<std::array<uint64_t, BINS>, 3> histograms{};
+        // Pixels with some channel at 0 (shadows) or 255 (highlights)
+        uint64_t clipped_shadows = 0;
+        uint64_t clipped_highlights = 0;
+        // Pixels whose brightness differs sharply from the next on the row
+        uint64_t edges = 0;
+        // Pixels counted so far
+        uint64_t pixels = 0;
+
+        // Smallest and largest value of a channel (0 and -1 if empty)
+        int get_min(int channel) const;
+        int get_max(int channel) const;
+    };
+
+    explicit ImageStatistics(std::shared_ptr<const Image> image);
+    ~ImageStatistics();
+
+    // No copying
+    ImageStatistics(const ImageStatistics&) = delete;
+    ImageStatistics& operator=(const ImageStatistics&) = delete;
+
+    // Statistics of the bands that have been counted so far
+    Result get_result() const;
+
+    // Changes whenever another band has been counted
+    int get_version() const { return version_; }
+
+    bool is_complete() const;
+
+    // Fraction of the pixels counted so far that are edges (0 - 1), a cheap
+    // measure of how much fine detail the image has
+    double get_edge_density() const;
+
+    uint64_t get_total_pixels() const {
+        return static_cast<uint64_t>(image_->get_width()) *
+               image_->get_height();
+    }
+
+  private:
+    void count_band(int first_row, int rows);
+
+    std::shared_ptr<const Image> image_;
+    mutable std::mutex mutex_;
+    Result result_;
+    std::atomic<int> version_;
+    std::atomic<bool> cancelled_;
+    std::vector<std::future<void>> bands_;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef IMAGEVIEWER_IMAGE_STREAM_H_
+#define IMAGEVIEWER_IMAGE_STREAM_H_
+
+#include <cstddef>
+#include <functional>
+#include <imageviewer/Image.h>
+#include <imageviewer/ProgressivePng.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace imageviewer {
+
+// Images read from standard input, a named pipe (FIFO) or a local socket, on
+// a thread of its own. Each image that arrives replaces the one before it.
+// Images are shown while they arrive, where the format allows it: binary
+// PPM, PGM and PNG images row by row, interlaced PNG images pass by pass and
+// progressive JPEG images scan by scan. Other images (and the final version
+// of PNG and JPEG images) are decoded once all of their data is there.
+class ImageStream {
+  public:
+    struct Update {
+        std::shared_ptr<const Image> image;
+        // Rows of the image that have arrived, from the top. The rest of
+        // the image is still being written.
+        int rows;
+        // False while the image is a preview of one that is arriving
+        bool complete;
+    };
+
+    // True for "-" (standard input), "unix:{path}" (a local socket to
+    // connect to) and named pipes
+    static bool is_stream(const std::string& source);
+
+    // on_change is called from the stream thread when more has arrived
+    ImageStream(const std::string& source, std::function<void()> on_change);
+    ~ImageStream();
+
+    // No copying
+    ImageStream(const ImageStream&) = delete;
+    ImageStream& operator=(const ImageStream&) = delete;
+
+    // The latest image, if anything has arrived since the last call
+    bool take_update(Update& update);
+
+  private:
+    // What is known about the image that is arriving, and what of it has
+    // been shown. It starts over for the next image.
+    struct Progress {
+        // Where splitting the stream into images has got to, so that the
+        // data is not scanned again each time more of it arrives
+        size_t position = 0;
+        bool entropy_coded = false; // In the data of a JPEG scan
+        bool progressive = false;   // A progressive JPEG
+        // Complete scans of a JPEG, where the last one ends and how many
+        // of them have been shown
+        int scans = 0;
+        size_t scans_end = 0;
+        int shown_scans = 0;
+        // PPM or PGM being converted row by row
+        std::shared_ptr<Image> partial;
+        int partial_rows = 0;
+        std::unique_ptr<ProgressivePng> png;
+        bool preview_failed = false;
+    };
+
+    void run();
+    // Decodes what has arrived of the image at the start of the buffer.
+    // Returns its size once it is complete, or 0 while more is needed.
+    size_t decode(const std::vector<unsigned char>& buffer);
+    // Shows what there is of an image that is still arriving
+    void show_preview(const unsigned char* data, size_t size);
+    // Size of the image file at the start of the data, once all of it has
+    // arrived, or 0 while more is needed
+    size_t find_image_end(const unsigned char* data, size_t size);
+    size_t find_png_end(const unsigned char* data, size_t size);
+    size_t find_jpeg_end(const unsigned char* data, size_t size);
+    void publish(std::shared_ptr<const Image> image, int rows,
+                 bool complete);
+
+    std::string source_;
+    std::function<void()> on_change_;
+    int fd_;
+    int stop_fd_;
+    // Used by the stream thread only
+    Progress progress_;
+    std::mutex mutex_;
+    Update update_;
+    bool changed_;
+    std::thread thread_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -17,30 +17,88 @@
 #ifndef IMAGEVIEWER_IMAGEVIEWER_H_
 #define IMAGEVIEWER_IMAGEVIEWER_H_
 
+#include <chrono>
+#include <future>
 #include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <imageviewer/Adjustments.h>
+#include <imageviewer/Animation.h>
+#include <imageviewer/ColorProfile.h>
+#include <imageviewer/ColorTransform.h>
+#include <imageviewer/CompareView.h>
+#include <imageviewer/DetailView.h>
+#include <imageviewer/FileWatcher.h>
+#include <imageviewer/FilterKernels.h>
+#include <imageviewer/FilterSelector.h>
+#include <imageviewer/HistogramView.h>
+#include <imageviewer/Image.h>
+#include <imageviewer/ImageStatistics.h>
+#include <imageviewer/ImageStream.h>
+#include <imageviewer/Orientation.h>
 #include <imageviewer/ShaderProgram.h>
 #include <imageviewer/SquareVertexArray.h>
 #include <imageviewer/Texture.h>
+#include <imageviewer/TiledImage.h>
+#include <imageviewer/ViewExport.h>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace imageviewer {
 
-enum class FilterType {
-    AUTO = 0,
-    BOX = 1,
-    TENT = 2,
-    GAUSSIAN = 3,
-    LANCZOS = 4
+// An image file ready to be shown: decoded, or memory mapped with a preview
+// if it is large. Loading does not need the GL context.
+struct LoadedImage {
+    std::string filename;
+    std::unique_ptr<TiledImage> tiled_image;
+    // The image, or the preview of the tiled image
+    std::shared_ptr<const Image> image;
 };
 
+LoadedImage load_image(const std::string& filename);
+
+// Loads on a thread of its own, which can start before there is a window
+std::future<LoadedImage> load_image_async(const std::string& filename);
+
 class ImageViewer {
   public:
     ImageViewer(const std::string& image_filename, GLFWwindow* window);
+    // Compiles the shaders while the image is loading, then waits for it
+    ImageViewer(std::future<LoadedImage> loading, GLFWwindow* window);
+    ImageViewer(std::shared_ptr<const Image> image, GLFWwindow* window);
+    ~ImageViewer();
 
     void render(double time_delta);
 
+    // Seconds until the next frame of an animation should be rendered, or a
+    // negative value if nothing changes until the next event
+    double get_time_to_next_frame() const;
+
     void set_size(int width, int height);
 
+    void set_filter_type(FilterType filter_type);
+
+    // Profile of the display that the output is converted to (default sRGB)
+    void set_display_profile(const ColorProfile& display_profile);
+
+    // Zoom to a fixed scale, centered on the image
+    void set_scale(double scale);
+
+    // Keep the image ETC2 compressed on the GPU, except when zoomed in to
+    // 100% or more, where the exact texels are used
+    void set_compressed(bool compressed);
+
+    // Size of exported views, relative to the window
+    void set_export_scale(double export_scale);
+
+    // GPU time for drawing the image with the Auto filter, which it keeps
+    // within by taking cheaper filters when it has to
+    void set_filter_budget(double milliseconds);
+
+    // Adds an image to compare with, shown next to the main image with the
+    // same camera
+    void add_compare_image(const std::string& filename);
+
     void key_event(int key, int action);
 
     void scroll_event(double offset, glm::dvec2 pos);
@@ -50,18 +108,94 @@ class ImageViewer {
     void mouse_move_event(glm::dvec2 pos);
 
   private:
+    // Sets up everything that does not depend on the image
+    explicit ImageViewer(GLFWwindow* window);
+
+    void open(LoadedImage loaded);
+
+    void check_for_reload();
+    void apply_reload();
+    void check_for_shader_reload();
+    void check_for_stream();
+    Texture& get_resident_texture();
+    // Uploads the image, halved as many times as needed to fit in GPU
+    // memory. It is drawn the same way at any size, as the texel scale
+    // comes from the size of the texture.
+    Texture upload_image();
+    void draw_view(const glm::dmat4& transform_pos, double scale,
+                   const glm::dmat4& output_transform);
+    void draw_texture(Texture& texture, const glm::dmat4& transform_pos,
+                      double texel_scale);
+    void update_detail(const glm::dmat4& transform_pos);
+    void draw_detail(const glm::dmat4& transform_pos, double scale);
+    void start_export();
+    void continue_export();
+    glm::dmat4 get_transform_pos();
+    void draw_histogram();
+    void set_filter_uniforms(const ShaderProgram& shader,
+                             const glm::dmat4& transform_pos,
+                             double texel_scale);
+    glm::dvec2 get_view_size();
     void calc_best_fit();
     void update_window_title();
+    std::string get_pixel_description();
     std::string get_filter_name();
 
     GLFWwindow* window_;
+    std::shared_ptr<const Image> image_;
+    std::string filename_;
     Texture texture_;
+    Texture compressed_texture_;
+    bool compressed_;
     ShaderProgram shader_;
     SquareVertexArray square_;
+    ColorProfile source_profile_;
+    ColorProfile display_profile_;
+    ColorTransform color_transform_;
+    Adjustments adjustments_;
+    Orientation orientation_;
+    std::unique_ptr<CompareView> compare_;
+    std::unique_ptr<Animation> animation_;
+    // Full resolution regions of a large image that is shown by a preview
+    std::unique_ptr<DetailView> detail_;
+    // Live reload when the file changes. The new image and the rectangles
+    // that differ are valid once reloading_ is ready.
+    std::unique_ptr<FileWatcher> watcher_;
+    std::future<void> reloading_;
+    std::chrono::steady_clock::time_point reload_start_;
+    std::shared_ptr<const Image> reloaded_;
+    std::vector<glm::ivec4> reloaded_changes_;
+    // Images read from standard input, a pipe or a socket, the rows of the
+    // current one that have been uploaded and if it is complete (or a
+    // preview of an image that is arriving)
+    std::unique_ptr<ImageStream> stream_;
+    int stream_rows_;
+    bool stream_complete_;
+    std::unique_ptr<ImageStatistics> statistics_;
+    std::unique_ptr<HistogramView> histogram_view_;
+    int histogram_version_;
+    bool inspector_;
+    // Kernels from kernels.txt, and the one in use (or -1 for filter_type_)
+    FilterKernels kernels_;
+    int kernel_;
+    // Picks the Auto filter. The filter that was drawn with last, at which
+    // texel scale, and the output pixels of the image being drawn (0 for
+    // exports, which take the best filter whatever it costs).
+    FilterSelector filter_selector_;
+    FilterChoice drawn_filter_;
+    double drawn_texel_scale_;
+    double drawn_pixels_;
+    std::unique_ptr<FileWatcher> shader_watcher_;
+    // The view being exported, as it was when the export started
+    std::unique_ptr<ViewExport> export_;
+    glm::dmat4 export_transform_;
+    double export_texel_scale_;
+    double export_scale_;
     double gaussian_sigma_;
     glm::dvec2 window_size_;
     glm::dvec2 image_size_;
     glm::dvec2 mouse_last_pos_;
+    glm::dvec2 mouse_pos_;
     bool mouse_down_;
     double scale_;
     glm::dvec2 translate_;
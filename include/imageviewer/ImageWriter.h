@@ -0,0 +1,30 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_IMAGE_WRITER_H_
+#define IMAGEVIEWER_IMAGE_WRITER_H_
+
+#include <string>
+
+namespace imageviewer {
+
+// Writes 8-bit RGB pixel data (top row first) as a PNG file
+void write_png(const std::string& filename, int width, int height,
+               const unsigned char* rgb);
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef IMAGEVIEWER_INFLATER_H_
+#define IMAGEVIEWER_INFLATER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace imageviewer {
+
+// Decompresses a zlib stream as its data arrives. Whatever can be decoded
+// from the input so far is output, and decoding continues where it stopped
+// when more input is added.
+class Inflater {
+  public:
+    Inflater();
+
+    void add_input(const unsigned char* data, size_t size);
+
+    // Decompresses as much of the input as possible. Throws if the data is
+    // not valid.
+    void inflate();
+
+    // True after the last block
+    bool is_done() const { return state_ == State::DONE; }
+
+    // Output that has not been taken yet
+    const unsigned char* get_output() const {
+        return output_.data() + taken_;
+    }
+    size_t get_output_size() const { return output_.size() - taken_; }
+
+    // Marks output as used. Only what later output can still refer back to
+    // is kept.
+    void take_output(size_t size);
+
+  private:
+    // Lookup table of a canonical Huffman code, indexed by the next bits
+    // of the input, with the symbol << 4 | code length in each entry
+    struct Huffman {
+        std::vector<uint16_t> table;
+        int bits = 0;
+    };
+
+    enum class State { HEADER, BLOCK, STORED, HUFFMAN, DONE };
+
+    // Each step either decodes something whole or returns false and is
+    // tried again with more input
+    bool step();
+    bool read_block_header();
+    bool read_dynamic_tables();
+    bool decode_symbol();
+    bool read_symbol(const Huffman& code, int& symbol);
+    bool read_bits(int count, uint32_t& value);
+    uint32_t peek_bits(int count) const;
+    size_t get_available_bits() const {
+        return input_.size() * 8 - position_;
+    }
+    static void build_code(Huffman& code, const uint8_t* lengths,
+                           int count);
+
+    std::vector<unsigned char> input_;
+    // Next bit of the input
+    size_t position_;
+    std::vector<unsigned char> output_;
+    size_t taken_;
+    State state_;
+    bool final_block_;
+    size_t stored_remaining_;
+    Huffman literals_;
+    Huffman distances_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_METADATA_INDEX_H_
+#define IMAGEVIEWER_METADATA_INDEX_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace imageviewer {
+
+enum class ImageFormat {
+    UNKNOWN = 0, // Not an image (that stb_image can decode)
+    JPEG = 1,
+    PNG = 2,
+    GIF = 3,
+    BMP = 4,
+    PSD = 5,
+    TGA = 6,
+    HDR = 7,
+    PIC = 8,
+    PNM = 9
+};
+
+const char* get_format_name(ImageFormat format);
+
+// What is known about an image file without decoding any pixels
+struct ImageInfo {
+    std::string filename; // Relative to the directory
+    uint64_t file_size = 0;
+    int64_t modified = 0; // Nanoseconds since the epoch
+    ImageFormat format = ImageFormat::UNKNOWN;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int bits_per_channel = 0;
+    int orientation = 1; // EXIF orientation (1 - 8)
+
+    bool is_image() const { return format != ImageFormat::UNKNOWN; }
+};
+
+// Reads the header (and EXIF orientation) of a file through a memory
+// mapping, so only the first pages are read from disk. Returns an
+// ImageFormat::UNKNOWN info for files that are not images.
+ImageInfo probe_image(const std::string& path);
+
+// Metadata of the images in a directory. The index is stored in the cache
+// directory, so reopening a directory only has to probe the files that are
+// new or have changed since (by size and modification time). Probing runs
+// on the shared thread pool.
+class MetadataIndex {
+  public:
+    // Loads the stored index for the directory, brings it up to date and
+    // stores it again if anything changed
+    explicit MetadataIndex(const std::string& directory);
+
+    const std::string& get_directory() const { return directory_; }
+
+    // All regular files in the directory, sorted by name
+    const std::vector<ImageInfo>& get_files() const { return files_; }
+
+    // Only the images
+    std::vector<ImageInfo> get_images() const;
+
+  private:
+    bool load(const std::string& index_file);
+    void save(const std::string& index_file) const;
+
+    std::string directory_;
+    std::vector<ImageInfo> files_;
+};
+
+} // namespace imageviewer
+
+#endif
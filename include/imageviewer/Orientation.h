@@ -0,0 +1,68 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_ORIENTATION_H_
+#define IMAGEVIEWER_ORIENTATION_H_
+
+#include <cstddef>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <string>
+
+namespace imageviewer {
+
+// How an image is turned for display: mirrored horizontally (first), then
+// rotated clockwise in quarter turns. It is applied to the drawn square,
+// so the pixels themselves are never moved.
+class Orientation {
+  public:
+    Orientation() : quarter_turns_{0}, mirrored_{false} {}
+
+    // From an EXIF orientation tag (1 - 8)
+    static Orientation from_exif(int value);
+
+    // These change the orientation as currently seen on screen
+    void rotate_clockwise();
+    void rotate_counterclockwise();
+    void flip_horizontal();
+    void flip_vertical();
+
+    bool is_identity() const { return quarter_turns_ == 0 && !mirrored_; }
+
+    int get_quarter_turns() const { return quarter_turns_; }
+
+    bool is_mirrored() const { return mirrored_; }
+
+    // Size on screen of an image with this orientation
+    glm::dvec2 apply_to_size(glm::dvec2 size) const;
+
+    // Transform for the square positions (-1 to 1)
+    glm::dmat4 get_transform() const;
+
+    std::string get_description() const;
+
+  private:
+    int quarter_turns_;
+    bool mirrored_;
+};
+
+// Reads the EXIF orientation tag of JPEG or PNG file data. Returns 1 (as
+// stored) if there is none.
+int extract_exif_orientation(const unsigned char* data, size_t size);
+
+} // namespace imageviewer
+
+#endif
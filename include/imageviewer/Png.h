@@ -0,0 +1,52 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_PNG_H_
+#define IMAGEVIEWER_PNG_H_
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace imageviewer {
+
+// Helpers shared by the PNG readers and writer
+
+// Every PNG file starts with these bytes
+inline constexpr unsigned char PNG_SIGNATURE[8]{0x89, 'P',  'N',  'G',
+                                                '\r', '\n', 0x1A, '\n'};
+
+// Big-endian 32-bit value, like chunk lengths and image sizes
+inline uint32_t read_be32(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0]) << 24 | data[1] << 16 |
+           data[2] << 8 | data[3];
+}
+
+// The Paeth predictor of filter type 4: whichever of the left, above and
+// upper left bytes is closest to left + above - upper left
+inline int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+} // namespace imageviewer
+
+#endif
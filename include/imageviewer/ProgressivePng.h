@@ -0,0 +1,83 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef IMAGEVIEWER_PROGRESSIVE_PNG_H_
+#define IMAGEVIEWER_PROGRESSIVE_PNG_H_
+
+#include <cstddef>
+#include <imageviewer/Image.h>
+#include <imageviewer/Inflater.h>
+#include <memory>
+#include <vector>
+
+namespace imageviewer {
+
+// Decodes a PNG file while it arrives, to show what there is of it so far.
+// Non-interlaced images are decoded row by row. Interlaced (Adam7) images
+// are decoded pass by pass, and each pixel of a pass is repeated over the
+// pixels of the passes after it. That gives a coarse image from the first
+// 1/64 of the pixels, which gets sharper with each pass.
+class ProgressivePng {
+  public:
+    ProgressivePng();
+
+    // Decodes the data that has arrived since the last call. The data is
+    // the start of the file, with more of it each time. Returns true if
+    // there are new rows or passes.
+    bool update(const unsigned char* data, size_t size);
+
+    // The image decoded so far (black elsewhere), or null until the header
+    // has arrived. The decoder writes to the rows after get_rows() of a
+    // non-interlaced image, and anywhere in an interlaced one.
+    const std::shared_ptr<Image>& get_image() const { return image_; }
+
+    bool is_interlaced() const { return interlaced_; }
+
+    // Rows decoded from the top, of a non-interlaced image
+    int get_rows() const {
+        return interlaced_ ? 0 : pass_ > 0 ? height_ : row_;
+    }
+
+    // Passes decoded, of an interlaced image
+    int get_passes() const { return interlaced_ ? pass_ : 0; }
+
+  private:
+    void read_header(const unsigned char* data, size_t size);
+    void decode_rows();
+    void write_row(int y, int x0, int dx, int block_width, int block_height,
+                   int width);
+
+    Inflater inflater_;
+    // Next chunk of the file, or the next data of an IDAT chunk
+    size_t position_;
+    size_t idat_remaining_;
+    int width_;
+    int height_;
+    int bit_depth_;
+    int color_type_;
+    int channels_;
+    bool interlaced_;
+    std::vector<unsigned char> palette_;
+    std::shared_ptr<Image> image_;
+    // Current pass and row in it. A non-interlaced image has one pass.
+    int pass_;
+    int row_;
+    std::vector<unsigned char> previous_row_;
+    std::vector<unsigned char> current_row_;
+};
+
+} // namespace imageviewer
+
+#endif
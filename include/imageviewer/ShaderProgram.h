@@ -19,15 +19,25 @@
 
 #include <imageviewer/glfw.h>
 
+#include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <map>
 #include <string>
+#include <vector>
 
 namespace imageviewer {
 
+// Shader sources generated at runtime, by the name they are included as
+using GeneratedSources = std::map<std::string, std::string>;
+
 class ShaderProgram {
   public:
     ShaderProgram();
-    ShaderProgram(std::string vertex_file, std::string fragment_file);
+    // #include "name" lines use the generated source by that name if there
+    // is one, and otherwise the file relative to the including file
+    ShaderProgram(std::string vertex_file, std::string fragment_file,
+                  const GeneratedSources& generated = {});
     ~ShaderProgram();
 
     // No copying
@@ -46,10 +56,17 @@ class ShaderProgram {
 
     void set_uniform(const std::string& name, GLfloat value) const;
 
+    void set_uniform(const std::string& name, const glm::mat3& matrix) const;
+
     void set_uniform(const std::string& name, const glm::mat4& matrix) const;
 
     void set_uniform(const std::string& name, const glm::vec2& vector) const;
 
+    void set_uniform(const std::string& name, const glm::ivec2& vector) const;
+
+    void set_uniform(const std::string& name,
+                     const std::vector<glm::vec2>& vectors) const;
+
   private:
     GLuint vert_shader_;
     GLuint frag_shader_;
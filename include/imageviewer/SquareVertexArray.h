@@ -36,7 +36,8 @@ class SquareVertexArray {
     SquareVertexArray(const SquareVertexArray&) = delete;
     SquareVertexArray& operator=(const SquareVertexArray&) = delete;
 
-    void render(const ShaderProgram& program);
+    // Draws the square, optionally several instances of it
+    void render(const ShaderProgram& program, int instances = 1);
 
   private:
     GLuint buffer_pos_;
@@ -0,0 +1,34 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_STARTUP_TRACE_H_
+#define IMAGEVIEWER_STARTUP_TRACE_H_
+
+#include <string>
+
+namespace imageviewer {
+
+// Prints the time since the program started, at the end of each phase of
+// starting up. Phases may end on any thread. Does nothing once the trace
+// has ended.
+void trace_startup(const std::string& phase);
+
+// Ends the trace, when the first frame has been shown
+void end_startup_trace();
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,31 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_TEST_PATTERN_H_
+#define IMAGEVIEWER_TEST_PATTERN_H_
+
+#include <imageviewer/Image.h>
+
+namespace imageviewer {
+
+enum class TestPattern { ZONE_PLATE, EDGES, GRADIENT };
+
+// Synthetic images that stress the resampling filters
+Image make_test_pattern(TestPattern pattern, int size);
+
+} // namespace imageviewer
+
+#endif
@@ -19,14 +19,18 @@
 
 #include <imageviewer/glfw.h>
 
+#include <imageviewer/CompressedImage.h>
 #include <imageviewer/Image.h>
 
 namespace imageviewer {
 
 class Texture {
   public:
-    Texture() : texture_{0} {}
+    Texture() : texture_{0}, width_{0}, height_{0}, evictable_{false} {}
     explicit Texture(const Image& image);
+    explicit Texture(const CompressedImage& image);
+    // Black texture, to be filled in by update()
+    Texture(int width, int height);
     ~Texture();
 
     // No copying
@@ -37,15 +41,33 @@ class Texture {
     Texture(Texture&& other);
     Texture& operator=(Texture&& other);
 
+    // Replaces the texels with an image of the same size
+    void update(const Image& image);
+
+    // Replaces a rectangle of texels with the same pixels of the image
+    void update(const Image& image, int x, int y, int width, int height);
+
     void bind_to_unit(GLenum texture_unit);
 
+    // Lets GpuMemory release the texture when it needs the space and the
+    // texture has not been drawn lately. The owner checks is_valid() and
+    // makes it again.
+    void set_evictable();
+
+    bool is_valid() const { return texture_ != 0; }
+
     int get_width() { return width_; }
     int get_height() { return height_; }
 
   private:
+    // Generates and binds the texture, with storage for the given size
+    void allocate(GLenum internal_format, size_t bytes);
+    void release();
+
     GLuint texture_;
     int width_;
     int height_;
+    bool evictable_;
 };
 
 } // namespace imageviewer
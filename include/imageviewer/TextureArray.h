@@ -0,0 +1,73 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_TEXTURE_ARRAY_H_
+#define IMAGEVIEWER_TEXTURE_ARRAY_H_
+
+#include <imageviewer/glfw.h>
+
+#include <imageviewer/Image.h>
+#include <memory>
+#include <vector>
+
+namespace imageviewer {
+
+// Several images in one GL_TEXTURE_2D_ARRAY, one per layer. Layers are as
+// large as the largest image, and smaller images use the top left corner.
+class TextureArray {
+  public:
+    TextureArray()
+        : texture_{0}, width_{0}, height_{0}, layers_{0}, evictable_{false} {}
+    explicit TextureArray(
+        const std::vector<std::shared_ptr<const Image>>& images);
+    // Empty layers, to be filled with update_layer()
+    TextureArray(int width, int height, int layers);
+    ~TextureArray();
+
+    // No copying
+    TextureArray(const TextureArray&) = delete;
+    TextureArray& operator=(const TextureArray&) = delete;
+
+    // Allow moving
+    TextureArray(TextureArray&& other);
+    TextureArray& operator=(TextureArray&& other);
+
+    // Replaces the top left corner of a layer with the image
+    void update_layer(int layer, const Image& image);
+
+    void bind_to_unit(GLenum texture_unit);
+
+    // Lets GpuMemory release the layers when it needs the space (like
+    // Texture::set_evictable)
+    void set_evictable();
+
+    bool is_valid() const { return texture_ != 0; }
+
+  private:
+    // Generates and binds the texture, with storage for the layers
+    void allocate();
+    void release();
+
+    GLuint texture_;
+    int width_;
+    int height_;
+    int layers_;
+    bool evictable_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_THREAD_POOL_H_
+#define IMAGEVIEWER_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace imageviewer {
+
+class ThreadPool {
+  public:
+    explicit ThreadPool(unsigned int thread_count);
+    ~ThreadPool();
+
+    // No copying
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool with one thread per hardware thread, shared by the whole viewer
+    static ThreadPool& shared();
+
+    std::future<void> submit(std::function<void()> task);
+
+    // Runs task(0) ... task(count - 1) on the pool and waits for all of them.
+    // Rethrows the first exception thrown by a task.
+    void parallel_for(size_t count, const std::function<void(size_t)>& task);
+
+    unsigned int get_thread_count() const {
+        return static_cast<unsigned int>(threads_.size());
+    }
+
+  private:
+    void worker();
+
+    std::vector<std::thread> threads_;
+    std::deque<std::packaged_task<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopping_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_TILED_IMAGE_H_
+#define IMAGEVIEWER_TILED_IMAGE_H_
+
+#include <cstddef>
+#include <imageviewer/Image.h>
+#include <memory>
+#include <string>
+
+namespace imageviewer {
+
+// A large uncompressed image (binary PPM or PGM with 8-bit samples) that is
+// mapped into memory and decoded region by region. Only the pages of the
+// file that are looked at are read from disk.
+class TiledImage {
+  public:
+    // Returns nullptr if the file is not a binary PPM or PGM that is big
+    // enough to benefit from being decoded by region
+    static std::unique_ptr<TiledImage> open(const std::string& filename);
+
+    ~TiledImage();
+
+    // No copying
+    TiledImage(const TiledImage&) = delete;
+    TiledImage& operator=(const TiledImage&) = delete;
+
+    int get_width() const { return width_; }
+    int get_height() const { return height_; }
+
+    // The whole image reduced to at most max_size pixels on each side, by
+    // averaging blocks of pixels
+    std::shared_ptr<const Image> make_preview(int max_size) const;
+
+    // Decodes a rectangle at full resolution
+    Image decode_region(int x, int y, int width, int height) const;
+
+    // RGB value of a single pixel
+    void get_pixel(int x, int y, unsigned char rgb[3]) const;
+
+  private:
+    TiledImage(const unsigned char* mapping, size_t mapping_size,
+               size_t data_offset, int width, int height, int channels);
+
+    void read_row(int x, int y, int width, unsigned char* out) const;
+
+    // Averages the blocks of step x step pixels starting at row y into one
+    // row of the preview
+    void average_blocks(int y, int step, unsigned char* out) const;
+
+    const unsigned char* mapping_;
+    size_t mapping_size_;
+    const unsigned char* data_;
+    int width_;
+    int height_;
+    int channels_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGEVIEWER_VIEW_EXPORT_H_
+#define IMAGEVIEWER_VIEW_EXPORT_H_
+
+#include <imageviewer/glfw.h>
+
+#include <future>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <imageviewer/Framebuffer.h>
+#include <imageviewer/Image.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace imageviewer {
+
+// Renders the view into a PNG file of any size, in tiles. The caller draws
+// each tile between begin_tile() and end_tile(), a few per frame. Tiles are
+// read back through pixel buffers, which are only mapped once their fence
+// has signaled, so the pipeline never stalls. The file is encoded on the
+// thread pool once all tiles have arrived.
+class ViewExport {
+  public:
+    ViewExport(const std::string& filename, glm::ivec2 size);
+    ~ViewExport();
+
+    // No copying
+    ViewExport(const ViewExport&) = delete;
+    ViewExport& operator=(const ViewExport&) = delete;
+
+    bool has_next_tile() const { return next_tile_ < tiles_.size(); }
+
+    // Binds the framebuffer of the next tile and returns the transform from
+    // the whole output to the tile (in normalized device coordinates)
+    glm::dmat4 begin_tile();
+
+    // Starts reading back the tile that was just drawn
+    void end_tile();
+
+    // Copies the tiles that have been read back, and starts encoding once
+    // all of them have. Returns true when the file has been written (or
+    // failed to).
+    bool update();
+
+    const std::string& get_filename() const { return filename_; }
+
+    glm::ivec2 get_size() const { return size_; }
+
+  private:
+    struct Readback {
+        GLuint buffer;
+        GLsync fence;
+        glm::ivec4 tile;
+    };
+
+    std::string filename_;
+    glm::ivec2 size_;
+    // x, y (from the top), width and height of each tile
+    std::vector<glm::ivec4> tiles_;
+    size_t next_tile_;
+    size_t tiles_done_;
+    Framebuffer framebuffer_;
+    std::vector<Readback> readbacks_;
+    std::vector<GLuint> free_buffers_;
+    std::unique_ptr<Image> output_;
+    std::future<void> encoding_;
+};
+
+} // namespace imageviewer
+
+#endif
@@ -43,13 +43,33 @@ inline const char* get_gl_error_string(GLenum error) {
     }
 }
 
+// The driver ran out of memory (or a texture would not fit in the budget), so
+// that callers can fall back to something smaller
+class GlOutOfMemory : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
 inline void check_for_gl_error() {
     GLenum error = glGetError();
-    if (error != GL_NO_ERROR) {
+    if (error == GL_OUT_OF_MEMORY) {
+        throw GlOutOfMemory(get_gl_error_string(error));
+    } else if (error != GL_NO_ERROR) {
         throw std::runtime_error(get_gl_error_string(error));
     }
 }
 
+// Restores the pixel unpack parameters to their initial values, so that an
+// upload does not pick up the row length or offsets of an earlier one
+inline void reset_unpack_state() {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+}
+
 } // namespace imageviewer
 
 #endif
@@ -0,0 +1,105 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/Adjustments.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace imageviewer {
+
+namespace {
+
+const double MIN_LEVELS_RANGE = 0.01;
+
+// Keeps repeated steps from drifting away from the default values
+double round_step(double value) {
+    return std::round(value * 1000.0) / 1000.0;
+}
+
+} // namespace
+
+Adjustments::Adjustments() { reset(); }
+
+void Adjustments::change_exposure(double stops) {
+    exposure_ = round_step(exposure_ + stops);
+    std::cout << "Exposure: " << exposure_ << "\n";
+}
+
+void Adjustments::change_black_point(double change) {
+    black_ = std::clamp(round_step(black_ + change), 0.0,
+                        white_ - MIN_LEVELS_RANGE);
+    std::cout << "Black point: " << black_ << "\n";
+}
+
+void Adjustments::change_white_point(double change) {
+    white_ = std::clamp(round_step(white_ + change),
+                        black_ + MIN_LEVELS_RANGE, 1.0);
+    std::cout << "White point: " << white_ << "\n";
+}
+
+void Adjustments::change_gamma(double change) {
+    gamma_ = std::clamp(round_step(gamma_ + change), 0.1, 10.0);
+    std::cout << "Gamma: " << gamma_ << "\n";
+}
+
+void Adjustments::toggle_tone_mapping() {
+    tone_mapping_ = !tone_mapping_;
+    std::cout << "Tone mapping: " << tone_mapping_ << "\n";
+}
+
+void Adjustments::reset() {
+    exposure_ = 0.0;
+    black_ = 0.0;
+    white_ = 1.0;
+    gamma_ = 1.0;
+    tone_mapping_ = false;
+}
+
+bool Adjustments::is_identity() const {
+    return exposure_ == 0.0 && black_ == 0.0 && white_ == 1.0 &&
+           gamma_ == 1.0;
+}
+
+void Adjustments::apply(const ShaderProgram& shader) const {
+    // (value * 2^exposure - black) / (white - black), as one multiply-add
+    double range = white_ - black_;
+    double scale = std::exp2(exposure_) / range;
+    // The brightest source value (1.0) after exposure and levels, which
+    // extended Reinhard then maps to 1.0
+    double brightest = scale - black_ / range;
+    bool tone_map = tone_mapping_ && brightest > 1.0;
+
+    shader.set_uniform("adjust_enabled", is_identity() && !tone_map ? 0 : 1);
+    shader.set_uniform("adjust_scale", static_cast<float>(scale));
+    shader.set_uniform("adjust_offset", static_cast<float>(black_ / range));
+    shader.set_uniform("adjust_gamma_inv", static_cast<float>(1.0 / gamma_));
+    shader.set_uniform("tone_map_white2",
+                       tone_map ? static_cast<float>(brightest * brightest)
+                                : 0.0f);
+}
+
+std::string Adjustments::get_description() const {
+    char text[128];
+    std::snprintf(text, sizeof(text),
+                  "%+.2f EV, levels %.2f-%.2f, gamma %.2f", exposure_, black_,
+                  white_, gamma_);
+    return std::string(text) + (tone_mapping_ ? ", tone mapped" : "");
+}
+
+} // namespace imageviewer
@@ -0,0 +1,199 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/Animation.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <imageviewer/Png.h>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace imageviewer {
+
+namespace {
+
+// Checks the signature, and for PNG whether an animation control chunk
+// comes before the image data, without reading the rest of the file
+bool may_be_animated(std::istream& in) {
+    unsigned char header[8];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        return false;
+    } else if (std::memcmp(header, "GIF8", 4) == 0) {
+        return true;
+    } else if (std::memcmp(header, PNG_SIGNATURE, sizeof(header)) != 0) {
+        return false;
+    }
+    unsigned char chunk[8]; // Length and type
+    while (in.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+        if (std::memcmp(chunk + 4, "acTL", 4) == 0) {
+            return true;
+        } else if (std::memcmp(chunk + 4, "IDAT", 4) == 0) {
+            return false;
+        }
+        // Skip the data and the CRC
+        in.seekg(std::streamoff(read_be32(chunk)) + 4, std::ios::cur);
+    }
+    return false;
+}
+
+} // namespace
+
+std::unique_ptr<Animation> Animation::open(const std::string& filename) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+    // Most images are still, and have already been read once
+    if (!may_be_animated(in)) {
+        return nullptr;
+    }
+    in.seekg(0);
+    std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)),
+                                    std::istreambuf_iterator<char>());
+    std::unique_ptr<FrameDecoder> decoder =
+        open_frame_decoder(std::move(file));
+    if (!decoder) {
+        return nullptr;
+    }
+    return std::make_unique<Animation>(std::move(decoder));
+}
+
+Animation::Animation(std::unique_ptr<FrameDecoder> decoder)
+    : decoder_{std::move(decoder)}, stop_{false}, finished_{false},
+      ring_head_{0}, ring_count_{0}, elapsed_{0.0} {
+    width_ = decoder_->get_width();
+    height_ = decoder_->get_height();
+    std::cout << "Animation: " << width_ << "x" << height_ << "\n";
+    thread_ = std::thread(&Animation::decode_frames, this);
+}
+
+Animation::~Animation() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    queue_changed_.notify_all();
+    thread_.join();
+}
+
+void Animation::update(double time_delta) {
+    bool had_frame = has_frame();
+    upload_frames();
+    if (!has_frame()) {
+        return;
+    } else if (!had_frame) {
+        elapsed_ = 0.0; // First frame
+        return;
+    }
+    elapsed_ += time_delta;
+    while (ring_count_ > 1 && elapsed_ >= delays_ms_[ring_head_] / 1000.0) {
+        elapsed_ -= delays_ms_[ring_head_] / 1000.0;
+        ring_head_ = (ring_head_ + 1) % RING_TEXTURES;
+        ring_count_--;
+        upload_frames();
+    }
+    // If decoding falls behind, the next frame is shown as soon as it is
+    // ready, rather than skipping frames to catch up later
+    elapsed_ = std::min(elapsed_, delays_ms_[ring_head_] / 1000.0);
+}
+
+double Animation::get_time_to_next_frame() const {
+    if (ring_count_ < 2) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Poll until the decoder has caught up
+        return finished_ && queue_.empty() ? -1.0 : 0.005;
+    }
+    return std::max(delays_ms_[ring_head_] / 1000.0 - elapsed_, 0.0);
+}
+
+void Animation::decode_frames() {
+    try {
+        int frame_count = 0; // Frames decoded since the last rewind
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queue_changed_.wait(lock, [this] {
+                    return stop_ || queue_.size() < QUEUE_FRAMES;
+                });
+                if (stop_) {
+                    return;
+                }
+            }
+            Image image = take_free_image();
+            int delay_ms = 0;
+            bool decoded = decoder_->next_frame(image, delay_ms);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (decoded) {
+                queue_.push_back(Frame{std::move(image), delay_ms});
+                frame_count++;
+                continue;
+            }
+            free_images_.push_back(std::move(image));
+            if (frame_count == 0) {
+                break; // Nothing to loop
+            }
+            // Loop forever by decoding the frames again
+            decoder_->rewind();
+            frame_count = 0;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to decode animation: " << e.what() << "\n";
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+}
+
+Image Animation::take_free_image() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_images_.empty()) {
+            Image image = std::move(free_images_.back());
+            free_images_.pop_back();
+            return image;
+        }
+    }
+    return Image(width_, height_);
+}
+
+void Animation::upload_frames() {
+    while (ring_count_ < RING_TEXTURES) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return;
+        }
+        Frame frame = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        queue_changed_.notify_one();
+
+        // Reuse the texture that was shown before the current frame
+        int slot = (ring_head_ + ring_count_) % RING_TEXTURES;
+        if (ring_[slot].is_valid()) {
+            ring_[slot].update(frame.image);
+        } else {
+            ring_[slot] = Texture(frame.image);
+        }
+        delays_ms_[slot] = frame.delay_ms;
+        ring_count_++;
+
+        lock.lock();
+        free_images_.push_back(std::move(frame.image));
+    }
+}
+
+} // namespace imageviewer
@@ -0,0 +1,248 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/BufferPool.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <sys/mman.h>
+
+namespace imageviewer {
+
+namespace {
+
+// Smaller allocations are left to malloc
+const size_t MIN_POOLED_SIZE = 1 << 20;
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+// Space before the data, keeping it aligned to cache lines
+const size_t HEADER_SIZE = 64;
+// Released blocks kept for reuse by the shared pool
+const size_t SHARED_CACHE_LIMIT = size_t(1) << 30;
+
+// Rounds up to one of four size classes per power of two, and to whole huge
+// pages, so that images of similar size can share blocks
+size_t get_class_size(size_t size) {
+    size_t step = HUGE_PAGE_SIZE;
+    while (step * 8 <= size) {
+        step *= 2;
+    }
+    return (size + step - 1) / step * step;
+}
+
+double to_mb(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+} // namespace
+
+struct BufferPool::Block {
+    size_t size; // Including the header
+    bool mapped; // Otherwise allocated with malloc
+    bool huge_pages;
+
+    unsigned char* get_data() {
+        return reinterpret_cast<unsigned char*>(this) + HEADER_SIZE;
+    }
+
+    static Block* from_data(void* data) {
+        return reinterpret_cast<Block*>(static_cast<unsigned char*>(data) -
+                                        HEADER_SIZE);
+    }
+};
+
+BufferPool::BufferPool(size_t cache_limit)
+    : cache_limit_{cache_limit}, cached_bytes_{0}, mapped_bytes_{0},
+      huge_page_bytes_{0}, mappings_{0}, reused_{0} {
+    getrusage(RUSAGE_SELF, &last_usage_);
+}
+
+BufferPool::~BufferPool() {
+    for (auto& entry : free_blocks_) {
+        unmap_block(entry.second);
+    }
+}
+
+BufferPool& BufferPool::shared() {
+    static BufferPool pool(SHARED_CACHE_LIMIT);
+    return pool;
+}
+
+void* BufferPool::allocate(size_t size) {
+    if (size + HEADER_SIZE < MIN_POOLED_SIZE) {
+        Block* block =
+            static_cast<Block*>(std::malloc(size + HEADER_SIZE));
+        if (block == nullptr) {
+            return nullptr;
+        }
+        block->size = size + HEADER_SIZE;
+        block->mapped = false;
+        block->huge_pages = false;
+        return block->get_data();
+    }
+    Block* block = take_block(get_class_size(size + HEADER_SIZE));
+    return block != nullptr ? block->get_data() : nullptr;
+}
+
+void* BufferPool::reallocate(void* data, size_t size) {
+    if (data == nullptr) {
+        return allocate(size);
+    }
+    Block* block = Block::from_data(data);
+    if (!block->mapped && size + HEADER_SIZE < MIN_POOLED_SIZE) {
+        block = static_cast<Block*>(std::realloc(block, size + HEADER_SIZE));
+        if (block == nullptr) {
+            return nullptr;
+        }
+        block->size = size + HEADER_SIZE;
+        return block->get_data();
+    }
+    if (block->mapped && size + HEADER_SIZE <= block->size) {
+        return data; // Still fits
+    }
+    void* moved = allocate(size);
+    if (moved == nullptr) {
+        return nullptr;
+    }
+    std::memcpy(moved, data, std::min(block->size - HEADER_SIZE, size));
+    release(data);
+    return moved;
+}
+
+void BufferPool::release(void* data) {
+    if (data == nullptr) {
+        return;
+    }
+    Block* block = Block::from_data(data);
+    if (!block->mapped) {
+        std::free(block);
+        return;
+    }
+    std::vector<Block*> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_blocks_.emplace(block->size, block);
+        cached_bytes_ += block->size;
+        // Give back the largest blocks first when too much is kept
+        while (cached_bytes_ > cache_limit_) {
+            auto largest = std::prev(free_blocks_.end());
+            cached_bytes_ -= largest->first;
+            mapped_bytes_ -= largest->first;
+            if (largest->second->huge_pages) {
+                huge_page_bytes_ -= largest->first;
+            }
+            evicted.push_back(largest->second);
+            free_blocks_.erase(largest);
+        }
+    }
+    for (Block* evicted_block : evicted) {
+        unmap_block(evicted_block);
+    }
+}
+
+void BufferPool::report(const char* step) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::cout << step << ": " << usage.ru_minflt - last_usage_.ru_minflt
+              << " minor and " << usage.ru_majflt - last_usage_.ru_majflt
+              << " major page faults. Buffer pool: " << mappings_
+              << " blocks mapped, " << reused_ << " reused, "
+              << to_mb(mapped_bytes_) << " MB ("
+              << to_mb(huge_page_bytes_) << " MB huge pages, "
+              << to_mb(cached_bytes_) << " MB free)\n";
+    last_usage_ = usage;
+}
+
+BufferPool::Block* BufferPool::take_block(size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A free block up to one size class larger will do
+        auto it = free_blocks_.lower_bound(size);
+        if (it != free_blocks_.end() && it->first <= size + size / 4) {
+            Block* block = it->second;
+            cached_bytes_ -= it->first;
+            free_blocks_.erase(it);
+            reused_++;
+            return block;
+        }
+    }
+
+    // Reserved huge pages are used when available, otherwise transparent
+    // huge pages are requested for an ordinary mapping
+    bool huge_pages = false;
+    void* mapping = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge_pages = mapping != MAP_FAILED;
+#endif
+    if (mapping == MAP_FAILED) {
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(mapping, size, MADV_HUGEPAGE);
+#endif
+    }
+    Block* block = static_cast<Block*>(mapping);
+    block->size = size;
+    block->mapped = true;
+    block->huge_pages = huge_pages;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    mappings_++;
+    mapped_bytes_ += size;
+    if (huge_pages) {
+        huge_page_bytes_ += size;
+    }
+    return block;
+}
+
+void BufferPool::unmap_block(Block* block) { munmap(block, block->size); }
+
+PooledBuffer::PooledBuffer(size_t size)
+    : data_{static_cast<unsigned char*>(
+          BufferPool::shared().allocate(size))},
+      size_{size} {
+    if (data_ == nullptr) {
+        throw std::bad_alloc();
+    }
+}
+
+PooledBuffer::~PooledBuffer() { BufferPool::shared().release(data_); }
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other)
+    : data_{other.data_}, size_{other.size_} {
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) {
+    if (this != &other) {
+        BufferPool::shared().release(data_);
+        data_ = other.data_;
+        size_ = other.size_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+} // namespace imageviewer
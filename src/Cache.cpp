@@ -0,0 +1,65 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/Cache.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace imageviewer {
+
+std::string get_cache_dir() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        return std::string(xdg) + "/imageviewer";
+    } else if (const char* home = std::getenv("HOME")) {
+        return std::string(home) + "/.cache/imageviewer";
+    }
+    return "";
+}
+
+std::string get_cache_file_name(const std::string& key,
+                                const std::string& extension) {
+    std::string dir = get_cache_dir();
+    if (dir.empty()) {
+        return "";
+    }
+    std::ostringstream name;
+    name << dir << "/" << std::hex << std::hash<std::string>{}(key) << "."
+         << extension;
+    return name.str();
+}
+
+bool write_cache_file(const std::string& cache_file,
+                      const std::function<void(std::ostream&)>& write) {
+    std::error_code error;
+    std::filesystem::create_directories(get_cache_dir(), error);
+    const std::string temp_file = cache_file + ".tmp";
+    {
+        std::ofstream out(temp_file, std::ios::out | std::ios::binary);
+        write(out);
+        if (!out) {
+            out.close();
+            std::filesystem::remove(temp_file, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_file, cache_file, error);
+    return !error;
+}
+
+} // namespace imageviewer
@@ -0,0 +1,322 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/ColorProfile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stb_image.h>
+#include <stdexcept>
+
+namespace imageviewer {
+
+namespace {
+
+const int ICC_HEADER_SIZE = 128;
+
+uint32_t read_u32(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+           (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint16_t read_u16(const unsigned char* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+double read_s15fixed16(const unsigned char* p) {
+    return static_cast<int32_t>(read_u32(p)) / 65536.0;
+}
+
+bool has_signature(const unsigned char* p, const char* signature) {
+    return std::memcmp(p, signature, 4) == 0;
+}
+
+// Maps tag signatures to the tag data (offset and size checked)
+std::map<std::string, std::vector<unsigned char>>
+read_tags(const std::vector<unsigned char>& icc) {
+    if (icc.size() < ICC_HEADER_SIZE + 4) {
+        throw std::runtime_error("ICC profile too small");
+    }
+    uint32_t count = read_u32(&icc[ICC_HEADER_SIZE]);
+    std::map<std::string, std::vector<unsigned char>> tags;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t entry = ICC_HEADER_SIZE + 4 + i * 12;
+        if (entry + 12 > icc.size()) {
+            throw std::runtime_error("Truncated ICC tag table");
+        }
+        uint32_t offset = read_u32(&icc[entry + 4]);
+        uint32_t size = read_u32(&icc[entry + 8]);
+        if (offset > icc.size() || size > icc.size() - offset) {
+            throw std::runtime_error("Invalid ICC tag");
+        }
+        std::string signature(reinterpret_cast<const char*>(&icc[entry]), 4);
+        tags[signature] = std::vector<unsigned char>(
+            icc.begin() + offset, icc.begin() + offset + size);
+    }
+    return tags;
+}
+
+glm::dvec3 parse_xyz(const std::vector<unsigned char>& tag) {
+    if (tag.size() < 20 || !has_signature(&tag[0], "XYZ ")) {
+        throw std::runtime_error("Invalid ICC XYZ tag");
+    }
+    return glm::dvec3(read_s15fixed16(&tag[8]), read_s15fixed16(&tag[12]),
+                      read_s15fixed16(&tag[16]));
+}
+
+ToneCurve parse_curve(const std::vector<unsigned char>& tag) {
+    if (tag.size() >= 12 && has_signature(&tag[0], "curv")) {
+        size_t count = read_u32(&tag[8]);
+        if (count > (tag.size() - 12) / 2) {
+            throw std::runtime_error("Truncated ICC curve");
+        }
+        if (count == 0) {
+            return ToneCurve::gamma(1.0);
+        } else if (count == 1) {
+            return ToneCurve::gamma(read_u16(&tag[12]) / 256.0);
+        }
+        std::vector<double> values(count);
+        for (size_t i = 0; i < count; i++) {
+            values[i] = read_u16(&tag[12 + i * 2]) / 65535.0;
+        }
+        return ToneCurve::table(values);
+    } else if (tag.size() >= 12 && has_signature(&tag[0], "para")) {
+        const int param_counts[]{1, 3, 4, 5, 7};
+        int function_type = read_u16(&tag[8]);
+        if (function_type > 4 ||
+            tag.size() < 12 + param_counts[function_type] * 4u) {
+            throw std::runtime_error("Invalid ICC parametric curve");
+        }
+        double p[7]{};
+        for (int i = 0; i < param_counts[function_type]; i++) {
+            p[i] = read_s15fixed16(&tag[12 + i * 4]);
+        }
+        // Convert to the general form: Y = (aX + b)^g + e if X >= d,
+        // otherwise Y = cX + f
+        double g = p[0];
+        switch (function_type) {
+        case 0:
+            return ToneCurve::parametric({g, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0});
+        case 1:
+            return ToneCurve::parametric(
+                {g, p[1], p[2], 0.0, -p[2] / p[1], 0.0, 0.0});
+        case 2:
+            return ToneCurve::parametric(
+                {g, p[1], p[2], 0.0, -p[2] / p[1], p[3], p[3]});
+        case 3:
+            return ToneCurve::parametric(
+                {g, p[1], p[2], p[3], p[4], 0.0, 0.0});
+        default:
+            return ToneCurve::parametric(
+                {g, p[1], p[2], p[3], p[4], p[5], p[6]});
+        }
+    }
+    throw std::runtime_error("Unsupported ICC curve type");
+}
+
+std::vector<unsigned char> extract_png_icc(const unsigned char* data,
+                                           size_t size) {
+    size_t pos = 8;
+    while (pos + 12 <= size) {
+        uint32_t length = read_u32(data + pos);
+        const unsigned char* type = data + pos + 4;
+        const unsigned char* chunk = data + pos + 8;
+        if (length > size - pos - 12 || has_signature(type, "IDAT")) {
+            break;
+        }
+        if (has_signature(type, "iCCP")) {
+            // Profile name, null separator, compression method, zlib data
+            const unsigned char* end = chunk + length;
+            const unsigned char* p = static_cast<const unsigned char*>(
+                std::memchr(chunk, 0, length));
+            if (p == nullptr || p + 2 > end) {
+                break;
+            }
+            p += 2;
+            int out_length = 0;
+            char* profile = stbi_zlib_decode_malloc(
+                reinterpret_cast<const char*>(p), static_cast<int>(end - p),
+                &out_length);
+            if (profile == nullptr) {
+                break;
+            }
+            std::vector<unsigned char> icc(profile, profile + out_length);
+            stbi_image_free(profile);
+            return icc;
+        }
+        pos += length + 12;
+    }
+    return {};
+}
+
+std::vector<unsigned char> extract_jpeg_icc(const unsigned char* data,
+                                            size_t size) {
+    const char marker_name[] = "ICC_PROFILE";
+    std::map<int, std::vector<unsigned char>> parts;
+    size_t pos = 2;
+    while (pos + 4 <= size && data[pos] == 0xff) {
+        int marker = data[pos + 1];
+        if (marker == 0xd9 || marker == 0xda) {
+            break; // End of image or start of scan
+        }
+        size_t length = read_u16(data + pos + 2);
+        if (length < 2 || pos + 2 + length > size) {
+            break;
+        }
+        const unsigned char* segment = data + pos + 4;
+        size_t segment_size = length - 2;
+        if (marker == 0xe2 && segment_size > sizeof(marker_name) + 2 &&
+            std::memcmp(segment, marker_name, sizeof(marker_name)) == 0) {
+            int sequence = segment[sizeof(marker_name)];
+            const unsigned char* part = segment + sizeof(marker_name) + 2;
+            parts[sequence].assign(part, segment + segment_size);
+        }
+        pos += 2 + length;
+    }
+    std::vector<unsigned char> icc;
+    for (const auto& part : parts) {
+        icc.insert(icc.end(), part.second.begin(), part.second.end());
+    }
+    return icc;
+}
+
+} // namespace
+
+ToneCurve ToneCurve::gamma(double gamma) {
+    return parametric({gamma, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0});
+}
+
+ToneCurve ToneCurve::parametric(const std::vector<double>& params) {
+    ToneCurve curve;
+    curve.type_ = Type::PARAMETRIC;
+    curve.params_ = params;
+    return curve;
+}
+
+ToneCurve ToneCurve::table(const std::vector<double>& values) {
+    ToneCurve curve;
+    curve.type_ = Type::TABLE;
+    curve.table_ = values;
+    return curve;
+}
+
+double ToneCurve::to_linear(double value) const {
+    value = std::fmin(std::fmax(value, 0.0), 1.0);
+    if (type_ == Type::TABLE) {
+        double pos = value * (table_.size() - 1);
+        size_t index = std::min(static_cast<size_t>(pos), table_.size() - 2);
+        double t = pos - index;
+        return table_[index] * (1.0 - t) + table_[index + 1] * t;
+    }
+    const std::vector<double>& p = params_;
+    if (value >= p[4]) {
+        double base = p[1] * value + p[2];
+        return (base > 0.0 ? std::pow(base, p[0]) : 0.0) + p[5];
+    }
+    return p[3] * value + p[6];
+}
+
+double ToneCurve::from_linear(double value) const {
+    // Both parts of a parametric curve can be inverted directly, which is
+    // much faster for filling lookup tables
+    const std::vector<double>& p = params_;
+    if (type_ == Type::PARAMETRIC && p.size() == 7 && p[0] > 0.0 &&
+        p[1] > 0.0) {
+        if (value >= to_linear(p[4])) {
+            double base = value - p[5];
+            double x = base > 0.0 ? std::pow(base, 1.0 / p[0]) : 0.0;
+            x = std::fmax((x - p[2]) / p[1], p[4]);
+            return std::fmin(std::fmax(x, 0.0), 1.0);
+        } else if (p[3] > 0.0) {
+            double x = std::fmin((value - p[6]) / p[3], p[4]);
+            return std::fmin(std::fmax(x, 0.0), 1.0);
+        }
+    }
+    double low = 0.0;
+    double high = 1.0;
+    for (int i = 0; i < 40; i++) {
+        double mid = 0.5 * (low + high);
+        if (to_linear(mid) < value) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return 0.5 * (low + high);
+}
+
+ColorProfile::ColorProfile() : name_{"sRGB"} {
+    ToneCurve srgb = ToneCurve::parametric(
+        {2.4, 1.0 / 1.055, 0.055 / 1.055, 1.0 / 12.92, 0.04045, 0.0, 0.0});
+    curves_[0] = curves_[1] = curves_[2] = srgb;
+    // sRGB primaries, chromatically adapted to D50 (columns are R, G, B)
+    to_xyz_ = glm::dmat3(0.4360747, 0.2225045, 0.0139322, 0.3850649,
+                         0.7168786, 0.0971045, 0.1430804, 0.0606169,
+                         0.7141733);
+}
+
+ColorProfile ColorProfile::from_icc(const std::vector<unsigned char>& icc) {
+    if (icc.size() < ICC_HEADER_SIZE ||
+        !has_signature(&icc[16], "RGB ") ||
+        !has_signature(&icc[36], "acsp")) {
+        throw std::runtime_error("Not an RGB ICC profile");
+    }
+    auto tags = read_tags(icc);
+    const char* xyz_tags[]{"rXYZ", "gXYZ", "bXYZ"};
+    const char* trc_tags[]{"rTRC", "gTRC", "bTRC"};
+    ColorProfile profile;
+    for (int i = 0; i < 3; i++) {
+        if (tags.count(xyz_tags[i]) == 0 || tags.count(trc_tags[i]) == 0) {
+            throw std::runtime_error("Only matrix/TRC ICC profiles are "
+                                     "supported");
+        }
+        profile.to_xyz_[i] = parse_xyz(tags[xyz_tags[i]]);
+        profile.curves_[i] = parse_curve(tags[trc_tags[i]]);
+    }
+    profile.name_ = "ICC profile";
+    return profile;
+}
+
+ColorProfile ColorProfile::from_icc_file(const std::string& filename) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+    std::vector<unsigned char> icc((std::istreambuf_iterator<char>(in)),
+                                   std::istreambuf_iterator<char>());
+    ColorProfile profile = from_icc(icc);
+    profile.name_ = filename;
+    return profile;
+}
+
+std::vector<unsigned char> extract_icc_profile(const unsigned char* data,
+                                               size_t size) {
+    const unsigned char png_signature[]{0x89, 'P', 'N', 'G'};
+    if (size >= 8 && std::memcmp(data, png_signature, 4) == 0) {
+        return extract_png_icc(data, size);
+    } else if (size >= 4 && data[0] == 0xff && data[1] == 0xd8) {
+        return extract_jpeg_icc(data, size);
+    }
+    return {};
+}
+
+} // namespace imageviewer
@@ -0,0 +1,128 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/ColorTransform.h>
+
+#include <cmath>
+#include <glm/matrix.hpp>
+#include <iostream>
+#include <vector>
+
+namespace imageviewer {
+
+namespace {
+
+const int INPUT_LUT_SIZE = 256;
+// The output LUT is indexed by sqrt(value), to get more entries close to
+// black where display curves are steep
+const int OUTPUT_LUT_SIZE = 4096;
+
+GLuint create_lut(GLenum internal_format, const std::vector<float>& rgba,
+                  GLenum filter) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format,
+                 static_cast<GLsizei>(rgba.size() / 4), 1, 0, GL_RGBA,
+                 GL_FLOAT, rgba.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    check_for_gl_error();
+    return texture;
+}
+
+} // namespace
+
+ColorTransform::ColorTransform(const ColorProfile& source,
+                               const ColorProfile& display) {
+    std::cout << "Color transform: " << source.get_name() << " -> "
+              << display.get_name() << "\n";
+
+    std::vector<float> input(INPUT_LUT_SIZE * 4, 1.0f);
+    for (int i = 0; i < INPUT_LUT_SIZE; i++) {
+        for (int c = 0; c < 3; c++) {
+            input[i * 4 + c] = static_cast<float>(
+                source.get_curve(c).to_linear(i / (INPUT_LUT_SIZE - 1.0)));
+        }
+    }
+    // Exact per 8-bit value, so nearest sampling and full float precision
+    input_lut_ = create_lut(GL_RGBA32F, input, GL_NEAREST);
+
+    std::vector<float> output(OUTPUT_LUT_SIZE * 4, 1.0f);
+    for (int i = 0; i < OUTPUT_LUT_SIZE; i++) {
+        double u = i / (OUTPUT_LUT_SIZE - 1.0);
+        for (int c = 0; c < 3; c++) {
+            output[i * 4 + c] = static_cast<float>(
+                display.get_curve(c).from_linear(u * u));
+        }
+    }
+    // Half floats are filterable in OpenGL ES 3
+    output_lut_ = create_lut(GL_RGBA16F, output, GL_LINEAR);
+
+    gamut_transform_ = glm::mat3(glm::inverse(display.get_to_xyz()) *
+                                 source.get_to_xyz());
+}
+
+ColorTransform::ColorTransform(ColorTransform&& other) {
+    input_lut_ = other.input_lut_;
+    output_lut_ = other.output_lut_;
+    gamut_transform_ = other.gamut_transform_;
+    other.input_lut_ = 0;
+    other.output_lut_ = 0;
+}
+
+ColorTransform& ColorTransform::operator=(ColorTransform&& other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (input_lut_ != 0) {
+        glDeleteTextures(1, &input_lut_);
+    }
+    if (output_lut_ != 0) {
+        glDeleteTextures(1, &output_lut_);
+    }
+    input_lut_ = other.input_lut_;
+    output_lut_ = other.output_lut_;
+    gamut_transform_ = other.gamut_transform_;
+    other.input_lut_ = 0;
+    other.output_lut_ = 0;
+    return *this;
+}
+
+ColorTransform::~ColorTransform() {
+    if (input_lut_ != 0) {
+        glDeleteTextures(1, &input_lut_);
+    }
+    if (output_lut_ != 0) {
+        glDeleteTextures(1, &output_lut_);
+    }
+}
+
+void ColorTransform::apply(const ShaderProgram& shader, GLint input_unit,
+                           GLint output_unit) {
+    glActiveTexture(GL_TEXTURE0 + input_unit);
+    glBindTexture(GL_TEXTURE_2D, input_lut_);
+    glActiveTexture(GL_TEXTURE0 + output_unit);
+    glBindTexture(GL_TEXTURE_2D, output_lut_);
+    check_for_gl_error();
+    shader.set_uniform("input_lut", input_unit);
+    shader.set_uniform("output_lut", output_unit);
+    shader.set_uniform("gamut_transform", gamut_transform_);
+}
+
+} // namespace imageviewer
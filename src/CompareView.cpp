@@ -0,0 +1,118 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/CompareView.h>
+
+#include <cmath>
+#include <config.h>
+#include <iostream>
+#include <stdexcept>
+
+namespace imageviewer {
+
+namespace {
+
+// Difference of 1/8 (in display values) is shown at full heatmap intensity
+const float DIFFERENCE_GAIN = 8.0f;
+
+} // namespace
+
+CompareView::CompareView(const GeneratedSources& generated)
+    : layout_{CompareLayout::SPLIT}, flip_index_{0}, difference_{false} {
+    reload_shader(generated);
+}
+
+void CompareView::reload_shader(const GeneratedSources& generated) {
+    shader_ = ShaderProgram(DATA_DIR "shaders/compare_vert.glsl",
+                            DATA_DIR "shaders/compare_frag.glsl", generated);
+}
+
+void CompareView::add_image(std::shared_ptr<const Image> image) {
+    if (images_.size() >= MAX_IMAGES) {
+        throw std::runtime_error("Too many images to compare");
+    }
+    images_.push_back(std::move(image));
+    texture_array_ = TextureArray();
+}
+
+glm::ivec2 CompareView::get_grid() const {
+    const int count = static_cast<int>(images_.size());
+    switch (layout_) {
+    case CompareLayout::SPLIT:
+        return glm::ivec2(count, 1);
+    case CompareLayout::GRID: {
+        int columns = static_cast<int>(std::ceil(std::sqrt(count)));
+        return glm::ivec2(columns, (count + columns - 1) / columns);
+    }
+    default:
+        return glm::ivec2(1, 1);
+    }
+}
+
+void CompareView::next_layout() {
+    layout_ = static_cast<CompareLayout>((static_cast<int>(layout_) + 1) % 3);
+}
+
+void CompareView::next_image() {
+    flip_index_ = (flip_index_ + 1) % images_.size();
+}
+
+void CompareView::toggle_difference() { difference_ = !difference_; }
+
+const ShaderProgram& CompareView::use(glm::dvec2 image_size) {
+    if (!texture_array_.is_valid()) {
+        texture_array_ = TextureArray(images_);
+    }
+    std::vector<glm::vec2> layer_sizes(MAX_IMAGES, glm::vec2(1.0f));
+    for (size_t i = 0; i < images_.size(); i++) {
+        layer_sizes[i] =
+            glm::vec2(images_[i]->get_width(), images_[i]->get_height());
+    }
+    const bool flip = layout_ == CompareLayout::FLIP;
+
+    shader_.use();
+    texture_array_.bind_to_unit(GL_TEXTURE0);
+    shader_.set_uniform("images", 0);
+    shader_.set_uniform("image_size", glm::vec2(image_size));
+    shader_.set_uniform("layer_sizes", layer_sizes);
+    shader_.set_uniform("grid", get_grid());
+    shader_.set_uniform("first_layer",
+                        flip ? static_cast<int>(flip_index_) : 0);
+    shader_.set_uniform("difference", difference_ ? 1 : 0);
+    shader_.set_uniform("difference_gain", DIFFERENCE_GAIN);
+    return shader_;
+}
+
+void CompareView::draw(SquareVertexArray& square) {
+    const bool flip = layout_ == CompareLayout::FLIP;
+    square.render(shader_, flip ? 1 : static_cast<int>(images_.size()));
+}
+
+std::string CompareView::get_description() const {
+    const char* layouts[]{"split", "grid", "flip"};
+    std::string description = "compare " +
+                              std::to_string(images_.size()) + " " +
+                              layouts[static_cast<int>(layout_)];
+    if (layout_ == CompareLayout::FLIP) {
+        description += " " + std::to_string(flip_index_ + 1);
+    }
+    if (difference_) {
+        description += " difference";
+    }
+    return description;
+}
+
+} // namespace imageviewer
@@ -0,0 +1,306 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/CompressedImage.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <imageviewer/Cache.h>
+#include <imageviewer/ThreadPool.h>
+#include <imageviewer/glfw.h>
+#include <iostream>
+#include <sstream>
+
+namespace imageviewer {
+
+namespace {
+
+const int BLOCK_BYTES = 8;
+const int BAND_BLOCK_ROWS = 16;
+const char CACHE_MAGIC[8]{'I', 'V', 'E', 'T', 'C', '2', 0, 1};
+
+// ETC1 intensity modifier tables (also used by ETC2)
+const int MODIFIERS[8][2]{{2, 8},   {5, 17},  {9, 29},   {13, 42},
+                          {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+struct SubblockFit {
+    int error;
+    int table;
+    uint32_t indices; // 2-bit modifier index per pixel, in pixel order
+};
+
+int clamp_byte(int value) { return std::min(std::max(value, 0), 255); }
+
+// Pixel numbering within a subblock, for the given flip mode and half
+void subblock_pixels(int flip, int half, int pixels[8]) {
+    int n = 0;
+    for (int x = 0; x < 4; x++) {
+        for (int y = 0; y < 4; y++) {
+            bool second = flip ? y >= 2 : x >= 2;
+            if (second == (half == 1)) {
+                pixels[n++] = x * 4 + y; // ETC pixel index (column major)
+            }
+        }
+    }
+}
+
+SubblockFit fit_subblock(const int block[16][3], const int pixels[8],
+                         const int base[3]) {
+    // The modifier is added to all channels, so ignoring clamping the best
+    // one is the closest to the mean difference from the base color
+    int offsets[8];
+    for (int i = 0; i < 8; i++) {
+        const int* p = block[pixels[i]];
+        offsets[i] = p[0] + p[1] + p[2] - base[0] - base[1] - base[2];
+    }
+    SubblockFit best{-1, 0, 0};
+    for (int table = 0; table < 8; table++) {
+        const int small = MODIFIERS[table][0];
+        const int large = MODIFIERS[table][1];
+        const int values[4]{small, large, -small, -large};
+        const int threshold = 3 * (small + large) / 2;
+        int error = 0;
+        uint32_t indices = 0;
+        for (int i = 0; i < 8; i++) {
+            int offset = offsets[i];
+            int index = offset >= 0 ? (offset < threshold ? 0 : 1)
+                                    : (-offset < threshold ? 2 : 3);
+            const int* p = block[pixels[i]];
+            for (int c = 0; c < 3; c++) {
+                int d = clamp_byte(base[c] + values[index]) - p[c];
+                error += d * d;
+            }
+            indices |= static_cast<uint32_t>(index) << (pixels[i] * 2);
+        }
+        if (best.error < 0 || error < best.error) {
+            best = {error, table, indices};
+        }
+    }
+    return best;
+}
+
+void average(const int block[16][3], const int pixels[8], double avg[3]) {
+    for (int c = 0; c < 3; c++) {
+        int sum = 0;
+        for (int i = 0; i < 8; i++) {
+            sum += block[pixels[i]][c];
+        }
+        avg[c] = sum / 8.0;
+    }
+}
+
+// Encodes a 4x4 block with the ETC1 individual and differential modes.
+// Differential mode is only used when the color difference fits, so the
+// blocks are decoded identically by ETC2 decoders.
+uint64_t encode_block(const int block[16][3]) {
+    uint64_t best_bits = 0;
+    int best_error = -1;
+    for (int flip = 0; flip < 2; flip++) {
+        int pixels[2][8];
+        double avg[2][3];
+        for (int half = 0; half < 2; half++) {
+            subblock_pixels(flip, half, pixels[half]);
+            average(block, pixels[half], avg[half]);
+        }
+        for (int differential = 0; differential < 2; differential++) {
+            int levels = differential ? 31 : 15;
+            int quantized[2][3];
+            int base[2][3];
+            for (int half = 0; half < 2; half++) {
+                for (int c = 0; c < 3; c++) {
+                    int q = static_cast<int>(avg[half][c] * levels / 255.0 +
+                                             0.5);
+                    quantized[half][c] = q;
+                    base[half][c] = differential ? (q << 3) | (q >> 2)
+                                                 : (q << 4) | q;
+                }
+            }
+            if (differential) {
+                bool fits = true;
+                for (int c = 0; c < 3; c++) {
+                    int delta = quantized[1][c] - quantized[0][c];
+                    fits = fits && delta >= -4 && delta <= 3;
+                }
+                if (!fits) {
+                    continue;
+                }
+            }
+            SubblockFit fits[2]{fit_subblock(block, pixels[0], base[0]),
+                                fit_subblock(block, pixels[1], base[1])};
+            int error = fits[0].error + fits[1].error;
+            if (best_error >= 0 && error >= best_error) {
+                continue;
+            }
+            best_error = error;
+
+            uint64_t bits = 0;
+            for (int c = 0; c < 3; c++) {
+                int shift = 59 - c * 8;
+                if (differential) {
+                    int delta = quantized[1][c] - quantized[0][c];
+                    bits |= uint64_t(quantized[0][c]) << shift;
+                    bits |= uint64_t(delta & 7) << (shift - 3);
+                } else {
+                    bits |= uint64_t(quantized[0][c]) << (shift + 1);
+                    bits |= uint64_t(quantized[1][c]) << (shift - 3);
+                }
+            }
+            bits |= uint64_t(fits[0].table) << 37;
+            bits |= uint64_t(fits[1].table) << 34;
+            bits |= uint64_t(differential) << 33;
+            bits |= uint64_t(flip) << 32;
+            for (int pixel = 0; pixel < 16; pixel++) {
+                int half = flip ? (pixel % 4) >= 2 : pixel >= 8;
+                int index = (fits[half].indices >> (pixel * 2)) & 3;
+                // Index 0..3 means +small, +large, -small, -large
+                int msb = index >= 2;
+                int lsb = index & 1;
+                bits |= uint64_t(msb) << (16 + pixel);
+                bits |= uint64_t(lsb) << pixel;
+            }
+            best_bits = bits;
+        }
+    }
+    return best_bits;
+}
+
+// Cache file name derived from the absolute path, size and modification time
+std::string get_cache_file(const std::string& source_file) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::path path = fs::absolute(source_file, error);
+    auto size = fs::file_size(path, error);
+    auto time = fs::last_write_time(path, error);
+    if (error) {
+        return "";
+    }
+    std::ostringstream key;
+    key << path.string() << "|" << size << "|"
+        << time.time_since_epoch().count();
+    return get_cache_file_name(key.str(), "etc2");
+}
+
+} // namespace
+
+CompressedImage::CompressedImage(const Image& image)
+    : width_{image.get_width()}, height_{image.get_height()} {
+    auto start = std::chrono::steady_clock::now();
+    const int columns = get_block_columns();
+    const int rows = get_block_rows();
+    data_.resize(static_cast<size_t>(columns) * rows * BLOCK_BYTES);
+
+    const int bands = (rows + BAND_BLOCK_ROWS - 1) / BAND_BLOCK_ROWS;
+    ThreadPool::shared().parallel_for(bands, [&](size_t band) {
+        int end_row = std::min<int>((band + 1) * BAND_BLOCK_ROWS, rows);
+        for (int row = band * BAND_BLOCK_ROWS; row < end_row; row++) {
+            for (int column = 0; column < columns; column++) {
+                int block[16][3];
+                for (int i = 0; i < 16; i++) {
+                    // Edge blocks are padded by repeating the last pixels
+                    int x = std::min(column * 4 + i / 4, width_ - 1);
+                    int y = std::min(row * 4 + i % 4, height_ - 1);
+                    const unsigned char* p =
+                        image.get_data() +
+                        (static_cast<size_t>(y) * width_ + x) * 3;
+                    block[i][0] = p[0];
+                    block[i][1] = p[1];
+                    block[i][2] = p[2];
+                }
+                uint64_t bits = encode_block(block);
+                unsigned char* out =
+                    &data_[(static_cast<size_t>(row) * columns + column) *
+                           BLOCK_BYTES];
+                for (int i = 0; i < BLOCK_BYTES; i++) {
+                    out[i] = static_cast<unsigned char>(bits >> (56 - i * 8));
+                }
+            }
+        }
+    });
+
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    double megapixels = static_cast<double>(width_) * height_ / 1e6;
+    std::cout << "Encoded ETC2: " << megapixels << " MP in " << seconds.count()
+              << " s (" << megapixels / seconds.count() << " MP/s, "
+              << ThreadPool::shared().get_thread_count() << " threads)\n";
+}
+
+CompressedImage
+CompressedImage::load_or_encode(const Image& image,
+                                const std::string& source_file) {
+    const std::string cache_file = get_cache_file(source_file);
+    CompressedImage cached;
+    if (!cache_file.empty() && cached.load_cache(cache_file) &&
+        cached.width_ == image.get_width() &&
+        cached.height_ == image.get_height()) {
+        std::cout << "Loaded ETC2 from cache: " << cache_file << "\n";
+        return cached;
+    }
+    CompressedImage encoded(image);
+    if (!cache_file.empty()) {
+        encoded.save_cache(cache_file);
+    }
+    return encoded;
+}
+
+bool CompressedImage::load_cache(const std::string& cache_file) {
+    std::ifstream in(cache_file, std::ios::in | std::ios::binary);
+    char magic[sizeof(CACHE_MAGIC)];
+    int32_t size[2];
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(size), sizeof(size))) {
+        return false;
+    }
+    // A corrupt or truncated file must not allocate more than it holds
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    if (size[0] <= 0 || size[1] <= 0 || size[0] > max_size ||
+        size[1] > max_size) {
+        return false;
+    }
+    width_ = size[0];
+    height_ = size[1];
+    const size_t data_size = static_cast<size_t>(get_block_columns()) *
+                             get_block_rows() * BLOCK_BYTES;
+    const std::streamoff start = in.tellg();
+    in.seekg(0, std::ios::end);
+    if (!in || static_cast<size_t>(in.tellg() - start) != data_size) {
+        return false;
+    }
+    in.seekg(start);
+    data_.resize(data_size);
+    return static_cast<bool>(
+        in.read(reinterpret_cast<char*>(data_.data()), data_.size()));
+}
+
+void CompressedImage::save_cache(const std::string& cache_file) const {
+    bool written = write_cache_file(cache_file, [&](std::ostream& out) {
+        const int32_t size[2]{width_, height_};
+        out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        out.write(reinterpret_cast<const char*>(size), sizeof(size));
+        out.write(reinterpret_cast<const char*>(data_.data()), data_.size());
+    });
+    if (!written) {
+        std::cerr << "Failed to write ETC2 cache: " << cache_file << "\n";
+    }
+}
+
+} // namespace imageviewer
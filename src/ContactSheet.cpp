@@ -0,0 +1,416 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/ContactSheet.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <config.h>
+#include <future>
+#include <glm/common.hpp>
+#include <glm/vec4.hpp>
+#include <imageviewer/Orientation.h>
+#include <imageviewer/ThreadPool.h>
+#include <iostream>
+#include <mutex>
+
+namespace imageviewer {
+
+namespace {
+
+const int THUMBNAIL_SIZE = 128;
+const int CELL_SIZE = 144;
+const float SELECTION_BORDER = 3.0f;
+// Thumbnails kept on the GPU (about 100 MB), more than fit on any screen
+const int LAYERS = 2048;
+// The cells texture has a row of cell data per 64 cells
+const int CELLS_WIDTH = 64;
+const int MAX_CELLS = CELLS_WIDTH * CELLS_WIDTH;
+// Limits work per frame, to keep scrolling smooth while thumbnails arrive
+const size_t UPLOADS_PER_FRAME = 32;
+// Larger images get a placeholder, since decoding them takes too long
+const double MAX_SOURCE_PIXELS = 100e6;
+
+// States of an image that has no layer
+const int NOT_LOADED = -1;
+const int LOADING = -2;
+const int FAILED = -3;
+
+glm::ivec2 get_thumbnail_size(int width, int height) {
+    double scale =
+        std::min(1.0, static_cast<double>(THUMBNAIL_SIZE) /
+                          std::max(std::max(width, height), 1));
+    return glm::max(glm::ivec2(glm::round(glm::dvec2(width, height) * scale)),
+                    glm::ivec2(1));
+}
+
+// Scales down by averaging the pixels that each thumbnail pixel covers
+Image make_thumbnail(const Image& image) {
+    glm::ivec2 size = get_thumbnail_size(image.get_width(), image.get_height());
+    Image thumbnail(size.x, size.y);
+    const int width = image.get_width();
+    const int height = image.get_height();
+    for (int y = 0; y < size.y; y++) {
+        int y0 = y * height / size.y;
+        int y1 = std::max(y0 + 1, (y + 1) * height / size.y);
+        for (int x = 0; x < size.x; x++) {
+            int x0 = x * width / size.x;
+            int x1 = std::max(x0 + 1, (x + 1) * width / size.x);
+            unsigned int sum[3] = {0, 0, 0};
+            for (int sy = y0; sy < y1; sy++) {
+                const unsigned char* p =
+                    image.get_data() +
+                    (static_cast<size_t>(sy) * width + x0) * 3;
+                for (int sx = x0; sx < x1; sx++, p += 3) {
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                }
+            }
+            unsigned int count = (y1 - y0) * (x1 - x0);
+            unsigned char* out = thumbnail.get_data() +
+                                 (static_cast<size_t>(y) * size.x + x) * 3;
+            for (int c = 0; c < 3; c++) {
+                out[c] =
+                    static_cast<unsigned char>((sum[c] + count / 2) / count);
+            }
+        }
+    }
+    return thumbnail;
+}
+
+} // namespace
+
+struct ContactSheet::Thumbnails {
+    struct Result {
+        int index;
+        std::unique_ptr<Image> thumbnail; // nullptr if it failed
+        bool skipped;                     // No longer wanted when started
+    };
+
+    std::mutex mutex;
+    std::vector<Result> results;
+    // Tasks for images outside of this range skip them
+    std::atomic<int> wanted_first{0};
+    std::atomic<int> wanted_last{0};
+    std::vector<std::future<void>> tasks;
+};
+
+ContactSheet::ContactSheet(const std::string& directory, GLFWwindow* window)
+    : window_{window}, images_{MetadataIndex(directory).get_images()},
+      directory_{directory}, layers_(images_.size(), NOT_LOADED),
+      layer_images_(LAYERS, -1), layer_frames_(LAYERS, 0), frame_{0},
+      thumbnails_{std::make_shared<Thumbnails>()},
+      texture_array_{THUMBNAIL_SIZE, THUMBNAIL_SIZE, LAYERS}, cells_{0},
+      window_size_{1.0}, scroll_{0.0}, selected_{0} {
+    texture_array_.set_evictable();
+    glGenTextures(1, &cells_);
+    glBindTexture(GL_TEXTURE_2D, cells_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32I, CELLS_WIDTH, CELLS_WIDTH);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    check_for_gl_error();
+    shader_ = ShaderProgram(DATA_DIR "shaders/contact_vert.glsl",
+                            DATA_DIR "shaders/contact_frag.glsl");
+    std::cout << "Contact sheet of " << images_.size() << " images\n";
+    update_window_title();
+}
+
+ContactSheet::~ContactSheet() {
+    // Queued tasks skip their images, so this only waits for the running
+    thumbnails_->wanted_last = 0;
+    for (std::future<void>& task : thumbnails_->tasks) {
+        task.wait();
+    }
+    glDeleteTextures(1, &cells_);
+}
+
+void ContactSheet::render() {
+    frame_++;
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (!texture_array_.is_valid()) {
+        // Released for something else while an image was open, so the
+        // thumbnails are made again
+        texture_array_ = TextureArray(THUMBNAIL_SIZE, THUMBNAIL_SIZE, LAYERS);
+        texture_array_.set_evictable();
+        for (int i = 0; i < LAYERS; i++) {
+            if (layer_images_[i] >= 0) {
+                layers_[layer_images_[i]] = NOT_LOADED;
+                layer_images_[i] = -1;
+            }
+        }
+    }
+    upload_thumbnails();
+    if (images_.empty()) {
+        return;
+    }
+
+    const int count = static_cast<int>(images_.size());
+    const int columns = get_columns();
+    const int rows = (count + columns - 1) / columns;
+    scroll_ = glm::clamp(scroll_, 0.0,
+                         std::max(0.0, rows * CELL_SIZE - window_size_.y));
+    const int first_row = static_cast<int>(scroll_ / CELL_SIZE);
+    const int end_row = std::min(
+        rows, static_cast<int>(std::ceil((scroll_ + window_size_.y) /
+                                         CELL_SIZE)));
+    const int first = first_row * columns;
+    const int cells = std::min(std::min(end_row * columns, count) - first,
+                               std::min(MAX_CELLS, LAYERS / 2));
+    // Prefetch a screen above and below
+    const int screen = (end_row - first_row) * columns;
+    request_thumbnails(first, first + cells, std::max(0, first - screen),
+                       std::min(count, first + cells + screen));
+
+    std::vector<glm::ivec4> cell_data(
+        (cells + CELLS_WIDTH - 1) / CELLS_WIDTH * CELLS_WIDTH);
+    for (int i = 0; i < cells; i++) {
+        const ImageInfo& info = images_[first + i];
+        Orientation orientation = Orientation::from_exif(info.orientation);
+        glm::ivec2 size = get_thumbnail_size(info.width, info.height);
+        int layer = layers_[first + i];
+        if (layer >= 0) {
+            layer_frames_[layer] = frame_;
+        }
+        cell_data[i] = glm::ivec4(std::max(layer, -1), size.x, size.y,
+                                  orientation.get_quarter_turns() +
+                                      (orientation.is_mirrored() ? 4 : 0));
+    }
+    glBindTexture(GL_TEXTURE_2D, cells_);
+    reset_unpack_state(); // Rows of CELLS_WIDTH cells
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CELLS_WIDTH,
+                    static_cast<GLsizei>(cell_data.size() / CELLS_WIDTH),
+                    GL_RGBA_INTEGER, GL_INT, cell_data.data());
+    check_for_gl_error();
+
+    shader_.use();
+    texture_array_.bind_to_unit(GL_TEXTURE0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, cells_);
+    shader_.set_uniform("thumbnails", 0);
+    shader_.set_uniform("cells", 1);
+    shader_.set_uniform("window_size", glm::vec2(window_size_));
+    double left = std::floor((window_size_.x - columns * CELL_SIZE) / 2.0);
+    shader_.set_uniform("origin",
+                        glm::vec2(left, first_row * CELL_SIZE - scroll_));
+    shader_.set_uniform("cell_size", static_cast<float>(CELL_SIZE));
+    shader_.set_uniform("columns", columns);
+    shader_.set_uniform("selected", selected_ - first);
+    shader_.set_uniform("border", SELECTION_BORDER);
+    square_.render(shader_, cells);
+}
+
+double ContactSheet::get_time_to_next_frame() const {
+    // Finished tasks wake up the event loop, but uploads are limited per
+    // frame
+    std::lock_guard<std::mutex> lock(thumbnails_->mutex);
+    return thumbnails_->results.empty() ? -1.0 : 0.0;
+}
+
+void ContactSheet::set_size(int width, int height) {
+    window_size_ = glm::dvec2(std::max(width, 1), std::max(height, 1));
+    glViewport(0, 0, width, height);
+    select(selected_); // Keep it in view
+}
+
+void ContactSheet::key_event(int key, int action) {
+    if (action != GLFW_PRESS && action != GLFW_REPEAT) {
+        return;
+    }
+    const int columns = get_columns();
+    const int page =
+        std::max(1, static_cast<int>(window_size_.y / CELL_SIZE)) * columns;
+    if (key == GLFW_KEY_LEFT) {
+        select(selected_ - 1);
+    } else if (key == GLFW_KEY_RIGHT) {
+        select(selected_ + 1);
+    } else if (key == GLFW_KEY_UP) {
+        select(selected_ - columns);
+    } else if (key == GLFW_KEY_DOWN) {
+        select(selected_ + columns);
+    } else if (key == GLFW_KEY_PAGE_UP) {
+        select(selected_ - page);
+    } else if (key == GLFW_KEY_PAGE_DOWN) {
+        select(selected_ + page);
+    } else if (key == GLFW_KEY_HOME) {
+        select(0);
+    } else if (key == GLFW_KEY_END) {
+        select(static_cast<int>(images_.size()) - 1);
+    } else if (key == GLFW_KEY_ENTER && !images_.empty()) {
+        chosen_ = directory_ + "/" + images_[selected_].filename;
+    }
+}
+
+void ContactSheet::scroll_event(double offset) {
+    scroll_ -= offset * CELL_SIZE / 2.0;
+}
+
+void ContactSheet::mouse_button_event(int button, int action,
+                                      glm::dvec2 pos) {
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) {
+        return;
+    }
+    const int columns = get_columns();
+    double left = std::floor((window_size_.x - columns * CELL_SIZE) / 2.0);
+    int column = static_cast<int>(std::floor((pos.x - left) / CELL_SIZE));
+    int row = static_cast<int>(std::floor((pos.y + scroll_) / CELL_SIZE));
+    int index = row * columns + column;
+    if (column < 0 || column >= columns || row < 0 ||
+        index >= static_cast<int>(images_.size())) {
+        return;
+    }
+    if (index == selected_) {
+        chosen_ = directory_ + "/" + images_[index].filename;
+    } else {
+        select(index);
+    }
+}
+
+std::string ContactSheet::take_chosen() {
+    std::string chosen;
+    std::swap(chosen, chosen_);
+    return chosen;
+}
+
+int ContactSheet::get_columns() const {
+    return std::max(1, static_cast<int>(window_size_.x / CELL_SIZE));
+}
+
+void ContactSheet::request_thumbnails(int first, int last,
+                                      int prefetch_first, int prefetch_last) {
+    Thumbnails& thumbnails = *thumbnails_;
+    thumbnails.wanted_first = prefetch_first;
+    thumbnails.wanted_last = prefetch_last;
+    thumbnails.tasks.erase(
+        std::remove_if(thumbnails.tasks.begin(), thumbnails.tasks.end(),
+                       [](std::future<void>& task) {
+                           return task.wait_for(std::chrono::seconds(0)) ==
+                                  std::future_status::ready;
+                       }),
+        thumbnails.tasks.end());
+
+    // Visible thumbnails first, then those below and above
+    const size_t max_tasks = ThreadPool::shared().get_thread_count() * 2;
+    std::vector<int> order;
+    for (int i = first; i < last; i++) {
+        order.push_back(i);
+    }
+    for (int i = last; i < prefetch_last; i++) {
+        order.push_back(i);
+    }
+    for (int i = first - 1; i >= prefetch_first; i--) {
+        order.push_back(i);
+    }
+    for (int index : order) {
+        if (thumbnails.tasks.size() >= max_tasks) {
+            break;
+        }
+        if (layers_[index] != NOT_LOADED) {
+            continue;
+        }
+        layers_[index] = LOADING;
+        const ImageInfo& info = images_[index];
+        std::string path = directory_ + "/" + info.filename;
+        bool too_large =
+            static_cast<double>(info.width) * info.height > MAX_SOURCE_PIXELS;
+        std::shared_ptr<Thumbnails> shared = thumbnails_;
+        thumbnails.tasks.push_back(ThreadPool::shared().submit(
+            [shared, index, path, too_large] {
+                Thumbnails::Result result{index, nullptr, false};
+                if (index < shared->wanted_first ||
+                    index >= shared->wanted_last) {
+                    result.skipped = true;
+                } else if (!too_large) {
+                    try {
+                        result.thumbnail = std::make_unique<Image>(
+                            make_thumbnail(Image(path)));
+                    } catch (const std::exception& e) {
+                        std::cerr << "No thumbnail for " << path << ": "
+                                  << e.what() << "\n";
+                    }
+                }
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->results.push_back(std::move(result));
+                glfwPostEmptyEvent();
+            }));
+    }
+}
+
+void ContactSheet::upload_thumbnails() {
+    std::vector<Thumbnails::Result> results;
+    {
+        std::lock_guard<std::mutex> lock(thumbnails_->mutex);
+        std::vector<Thumbnails::Result>& pending = thumbnails_->results;
+        size_t count = std::min(pending.size(), UPLOADS_PER_FRAME);
+        std::move(pending.begin(), pending.begin() + count,
+                  std::back_inserter(results));
+        pending.erase(pending.begin(), pending.begin() + count);
+    }
+    for (Thumbnails::Result& result : results) {
+        if (result.skipped) {
+            layers_[result.index] = NOT_LOADED;
+            continue;
+        } else if (!result.thumbnail) {
+            layers_[result.index] = FAILED;
+            continue;
+        }
+        // A free layer, or else the one that has been out of view longest
+        int layer = 0;
+        for (int i = 0; i < LAYERS; i++) {
+            if (layer_images_[i] < 0) {
+                layer = i;
+                break;
+            } else if (layer_frames_[i] < layer_frames_[layer]) {
+                layer = i;
+            }
+        }
+        if (layer_images_[layer] >= 0) {
+            layers_[layer_images_[layer]] = NOT_LOADED;
+        }
+        texture_array_.update_layer(layer, *result.thumbnail);
+        layer_images_[layer] = result.index;
+        layer_frames_[layer] = frame_;
+        layers_[result.index] = layer;
+    }
+}
+
+void ContactSheet::select(int index) {
+    if (images_.empty()) {
+        return;
+    }
+    selected_ = glm::clamp(index, 0, static_cast<int>(images_.size()) - 1);
+    double top = (selected_ / get_columns()) * CELL_SIZE;
+    scroll_ = glm::clamp(scroll_, top + CELL_SIZE - window_size_.y, top);
+    update_window_title();
+}
+
+void ContactSheet::update_window_title() {
+    std::string title =
+        "ImageViewer " + directory_ + " (" + std::to_string(images_.size()) +
+        " images)";
+    if (!images_.empty()) {
+        const ImageInfo& info = images_[selected_];
+        title += " " + std::to_string(selected_ + 1) + ": " + info.filename +
+                 " " + std::to_string(info.width) + "x" +
+                 std::to_string(info.height) + " " +
+                 get_format_name(info.format);
+    }
+    glfwSetWindowTitle(window_, title.c_str());
+}
+
+} // namespace imageviewer
@@ -0,0 +1,114 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/DetailView.h>
+
+#include <chrono>
+#include <glm/common.hpp>
+#include <imageviewer/ThreadPool.h>
+#include <iostream>
+
+namespace imageviewer {
+
+namespace {
+
+// Regions are aligned to this, with at least this much extra on each side,
+// so that small pans do not need a new region and the filters do not see
+// the region's edges
+const int REGION_ALIGNMENT = 128;
+
+bool contains(glm::ivec2 min, glm::ivec2 max, glm::ivec2 inner_min,
+              glm::ivec2 inner_max) {
+    return min.x <= inner_min.x && min.y <= inner_min.y &&
+           max.x >= inner_max.x && max.y >= inner_max.y;
+}
+
+} // namespace
+
+DetailView::DetailView(std::unique_ptr<TiledImage> image)
+    : image_{std::move(image)}, min_{0}, max_{0}, decoding_min_{0},
+      decoding_max_{0}, wanted_min_{0}, wanted_max_{0} {}
+
+DetailView::~DetailView() {
+    if (decoding_.valid()) {
+        decoding_.wait();
+    }
+}
+
+void DetailView::request(glm::ivec2 min, glm::ivec2 max) {
+    glm::ivec2 size(image_->get_width(), image_->get_height());
+    min = glm::clamp(min, glm::ivec2(0), size);
+    max = glm::clamp(max, glm::ivec2(0), size);
+    if (min.x >= max.x || min.y >= max.y ||
+        (texture_.is_valid() && contains(min_, max_, min, max)) ||
+        (decoding_.valid() &&
+         contains(decoding_min_, decoding_max_, min, max))) {
+        return;
+    }
+    // Add a margin and align
+    glm::ivec2 start = (min / REGION_ALIGNMENT - 1) * REGION_ALIGNMENT;
+    glm::ivec2 end = (max / REGION_ALIGNMENT + 2) * REGION_ALIGNMENT;
+    wanted_min_ = glm::clamp(start, glm::ivec2(0), size);
+    wanted_max_ = glm::clamp(end, glm::ivec2(0), size);
+    if (!decoding_.valid()) {
+        start_decoding(wanted_min_, wanted_max_);
+    }
+}
+
+void DetailView::update() {
+    if (!decoding_.valid() || decoding_.wait_for(std::chrono::seconds(0)) !=
+                                  std::future_status::ready) {
+        return;
+    }
+    decoding_.get();
+    if (texture_.is_valid() && texture_.get_width() == decoded_->get_width() &&
+        texture_.get_height() == decoded_->get_height()) {
+        texture_.update(*decoded_);
+    } else {
+        texture_ = Texture(*decoded_);
+        texture_.set_evictable(); // Decoded again when needed
+    }
+    min_ = decoding_min_;
+    max_ = decoding_max_;
+    decoded_.reset();
+    // The view may have moved on while decoding
+    if (!contains(min_, max_, wanted_min_, wanted_max_)) {
+        start_decoding(wanted_min_, wanted_max_);
+    }
+}
+
+void DetailView::clear() {
+    texture_ = Texture();
+    wanted_min_ = wanted_max_ = glm::ivec2(0);
+}
+
+void DetailView::start_decoding(glm::ivec2 min, glm::ivec2 max) {
+    decoding_min_ = min;
+    decoding_max_ = max;
+    decoding_ = ThreadPool::shared().submit([this, min, max] {
+        auto start = std::chrono::steady_clock::now();
+        glm::ivec2 size = max - min;
+        decoded_ = std::make_unique<Image>(
+            image_->decode_region(min.x, min.y, size.x, size.y));
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << "Decoded region " << size.x << "x" << size.y << " at "
+                  << min.x << ", " << min.y << " ("
+                  << elapsed.count() * 1000.0 << " ms)\n";
+    });
+}
+
+} // namespace imageviewer
@@ -0,0 +1,125 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/FileWatcher.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace imageviewer {
+
+namespace {
+
+// Quiet time before a change is reported, while the file is being written
+// and after it has been closed or moved into place
+const int WRITING_DEBOUNCE_MS = 200;
+const int COMPLETE_DEBOUNCE_MS = 20;
+
+} // namespace
+
+FileWatcher::FileWatcher(const std::string& filename,
+                         std::function<void()> on_change)
+    : on_change_{std::move(on_change)}, changed_{false} {
+    size_t slash = filename.rfind('/');
+    std::string directory =
+        slash == std::string::npos ? "." : filename.substr(0, slash + 1);
+    name_ = slash == std::string::npos ? filename : filename.substr(slash + 1);
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        throw std::runtime_error("Failed to initialize inotify");
+    }
+    if (inotify_add_watch(inotify_fd_, directory.c_str(),
+                          IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(inotify_fd_);
+        throw std::runtime_error("Failed to watch " + directory);
+    }
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+        close(inotify_fd_);
+        throw std::runtime_error("Failed to create eventfd");
+    }
+    thread_ = std::thread(&FileWatcher::run, this);
+    std::cout << "Watching " << filename << " for changes\n";
+}
+
+FileWatcher::~FileWatcher() {
+    uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) != sizeof(one)) {
+        std::cerr << "Failed to stop the file watcher\n";
+    }
+    thread_.join();
+    close(stop_fd_);
+    close(inotify_fd_);
+}
+
+void FileWatcher::run() {
+    int timeout = -1; // Until something happens
+    while (true) {
+        pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        int ready = poll(fds, 2, timeout);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        } else if (ready < 0 || fds[1].revents != 0) {
+            return;
+        } else if (ready == 0) {
+            // Quiet for long enough
+            timeout = -1;
+            changed_ = true;
+            on_change_();
+            continue;
+        }
+        int state = read_events();
+        if (state == 2) {
+            timeout = COMPLETE_DEBOUNCE_MS;
+        } else if (state == 1) {
+            timeout = WRITING_DEBOUNCE_MS;
+        }
+    }
+}
+
+int FileWatcher::read_events() {
+    alignas(inotify_event) char buffer[4096];
+    int state = 0;
+    while (true) {
+        ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return state; // EAGAIN when everything has been read
+        }
+        for (ssize_t pos = 0; pos < length;) {
+            auto event = reinterpret_cast<const inotify_event*>(buffer + pos);
+            pos += sizeof(inotify_event) + event->len;
+            if (event->len == 0 ||
+                (!name_.empty() && name_ != event->name)) {
+                continue;
+            }
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                state = 2;
+            } else if (state == 0) {
+                state = 1;
+            }
+        }
+    }
+}
+
+} // namespace imageviewer
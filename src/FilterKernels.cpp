@@ -0,0 +1,256 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/FilterKernels.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace imageviewer {
+
+namespace {
+
+const double PI = 3.14159265358979;
+
+// Samples per kernel in the lookup table, from 0 to the support
+const int LUT_SIZE = 512;
+
+double sinc(double x) {
+    if (std::fabs(x) < 0.00001) {
+        return 1.0;
+    }
+    return std::sin(PI * x) / (PI * x);
+}
+
+// Modified Bessel function of the first kind, order 0
+double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+double mitchell_netravali(double x, double b, double c) {
+    if (x < 1.0) {
+        return ((12.0 - 9.0 * b - 6.0 * c) * x * x * x +
+                (-18.0 + 12.0 * b + 6.0 * c) * x * x + (6.0 - 2.0 * b)) /
+               6.0;
+    } else if (x < 2.0) {
+        return ((-b - 6.0 * c) * x * x * x + (6.0 * b + 30.0 * c) * x * x +
+                (-12.0 * b - 48.0 * c) * x + (8.0 * b + 24.0 * c)) /
+               6.0;
+    }
+    return 0.0;
+}
+
+// Linear interpolation in weights evenly spaced from 0 to 1
+double interpolate(const std::vector<double>& weights, double u) {
+    double pos = u * (weights.size() - 1);
+    size_t i = std::min(static_cast<size_t>(pos), weights.size() - 1);
+    size_t next = std::min(i + 1, weights.size() - 1);
+    return weights[i] + (weights[next] - weights[i]) * (pos - i);
+}
+
+// Formats a double for GLSL (always with a decimal point)
+std::string glsl_float(double value) {
+    std::ostringstream out;
+    out.precision(9);
+    out << std::showpoint << value;
+    return out.str();
+}
+
+} // namespace
+
+FilterKernels::FilterKernels(const std::string& filename) : lut_{0} {
+    std::ifstream in(filename);
+    if (!in) {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+    std::vector<float> lut;
+    std::string line;
+    for (int line_number = 1; std::getline(in, line); line_number++) {
+        std::istringstream words(line.substr(0, line.find('#')));
+        Kernel kernel{"", 0.0, "", -1};
+        std::string type;
+        if (!(words >> kernel.name)) {
+            continue; // Empty or only a comment
+        }
+        auto fail = [&](const std::string& message) {
+            throw std::runtime_error(filename + ":" +
+                                     std::to_string(line_number) + ": " +
+                                     message);
+        };
+        if (!(words >> type >> kernel.support) || kernel.support <= 0.0 ||
+            kernel.support > 8.0) {
+            fail("expected a kernel type and a support from 0 to 8");
+        }
+        std::vector<double> parameters;
+        if (type == "glsl") {
+            std::getline(words, kernel.expression);
+            if (kernel.expression.find_first_not_of(" \t") ==
+                std::string::npos) {
+                fail("expected a GLSL expression");
+            }
+        } else {
+            double value;
+            while (words >> value) {
+                parameters.push_back(value);
+            }
+            if (!words.eof()) {
+                fail("expected numbers after the support");
+            }
+        }
+
+        std::function<double(double)> weight;
+        if (type == "cubic" && parameters.size() == 2) {
+            double b = parameters[0];
+            double c = parameters[1];
+            weight = [b, c](double x) { return mitchell_netravali(x, b, c); };
+        } else if (type == "lanczos" && parameters.empty()) {
+            double a = kernel.support;
+            weight = [a](double x) { return sinc(x) * sinc(x / a); };
+        } else if (type == "kaiser" && parameters.size() == 1) {
+            double a = kernel.support;
+            double beta = parameters[0];
+            weight = [a, beta](double x) {
+                double t = x / a;
+                return sinc(x) *
+                       bessel_i0(beta * std::sqrt(std::max(1.0 - t * t, 0.0))) /
+                       bessel_i0(beta);
+            };
+        } else if (type == "table" && parameters.size() >= 2) {
+            double a = kernel.support;
+            weight = [a, parameters](double x) {
+                return interpolate(parameters, x / a);
+            };
+        } else if (type != "glsl") {
+            fail("unknown kernel type or wrong number of parameters");
+        }
+        if (weight) {
+            kernel.lut_row = static_cast<int>(lut.size() / LUT_SIZE);
+            for (int i = 0; i < LUT_SIZE; i++) {
+                lut.push_back(static_cast<float>(
+                    weight(kernel.support * i / (LUT_SIZE - 1.0))));
+            }
+        }
+        kernels_.push_back(kernel);
+    }
+
+    if (!lut.empty()) {
+        glGenTextures(1, &lut_);
+        glBindTexture(GL_TEXTURE_2D, lut_);
+        // Also loaded again while textures are in use, on hot reloads
+        reset_unpack_state();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, LUT_SIZE,
+                     static_cast<GLsizei>(lut.size() / LUT_SIZE), 0, GL_RED,
+                     GL_FLOAT, lut.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        check_for_gl_error();
+    }
+    std::cout << "Loaded " << kernels_.size() << " filter kernels from "
+              << filename << "\n";
+}
+
+FilterKernels::FilterKernels(FilterKernels&& other)
+    : kernels_{std::move(other.kernels_)}, lut_{other.lut_} {
+    other.lut_ = 0;
+}
+
+FilterKernels& FilterKernels::operator=(FilterKernels&& other) {
+    if (lut_ != 0 && lut_ != other.lut_) {
+        glDeleteTextures(1, &lut_);
+    }
+    kernels_ = std::move(other.kernels_);
+    lut_ = other.lut_;
+    other.lut_ = 0;
+    return *this;
+}
+
+FilterKernels::~FilterKernels() {
+    if (lut_ != 0) {
+        glDeleteTextures(1, &lut_);
+    }
+}
+
+GeneratedSources FilterKernels::get_shader_sources() const {
+    std::ostringstream code;
+    code << "// Generated from the kernel declarations\n";
+    if (lut_ != 0) {
+        code << "uniform sampler2D kernel_lut;\n\n"
+             << "float kernel_lut_weight(int row, float x, float support) {\n"
+             << "    float pos = x / support * float(" << LUT_SIZE - 1
+             << ");\n"
+             << "    int i = min(int(pos), " << LUT_SIZE - 2 << ");\n"
+             << "    float w0 = texelFetch(kernel_lut, ivec2(i, row), 0).r;\n"
+             << "    float w1 = texelFetch(kernel_lut, ivec2(i + 1, row), "
+                "0).r;\n"
+             << "    return mix(w0, w1, pos - float(i));\n"
+             << "}\n";
+    }
+    for (size_t i = 0; i < kernels_.size(); i++) {
+        if (kernels_[i].lut_row < 0) {
+            code << "\n// " << kernels_[i].name << "\n"
+                 << "float kernel_" << i << "(float x) {\n"
+                 << "    return " << kernels_[i].expression << ";\n"
+                 << "}\n";
+        }
+    }
+
+    code << "\nfloat kernel_width(int kernel) {\n";
+    for (size_t i = 0; i < kernels_.size(); i++) {
+        code << "    if (kernel == " << i << ") return "
+             << glsl_float(kernels_[i].support) << ";\n";
+    }
+    code << "    return 0.5;\n"
+         << "}\n\n"
+         << "float kernel_weight(int kernel, float x) {\n"
+         << "    x = abs(x);\n";
+    for (size_t i = 0; i < kernels_.size(); i++) {
+        const Kernel& kernel = kernels_[i];
+        code << "    if (kernel == " << i << ") return x >= "
+             << glsl_float(kernel.support) << " ? 0.0 : ";
+        if (kernel.lut_row < 0) {
+            code << "kernel_" << i << "(x);\n";
+        } else {
+            code << "kernel_lut_weight(" << kernel.lut_row << ", x, "
+                 << glsl_float(kernel.support) << ");\n";
+        }
+    }
+    code << "    return 1.0;\n"
+         << "}\n";
+    return GeneratedSources{{"kernels.glsl", code.str()}};
+}
+
+void FilterKernels::apply(const ShaderProgram& shader, GLint unit) const {
+    if (lut_ == 0) {
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, lut_);
+    check_for_gl_error();
+    shader.set_uniform("kernel_lut", unit);
+}
+
+} // namespace imageviewer
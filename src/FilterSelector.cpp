@@ -0,0 +1,269 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <imageviewer/FilterSelector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace imageviewer {
+
+namespace {
+
+const double PI = 3.14159265358979;
+
+const double DEFAULT_BUDGET = 8.0;
+// Edge densities (see ImageStatistics) of images with little fine detail,
+// and of images where edges are most of what is seen
+const double FEW_EDGES = 0.02;
+const double MANY_EDGES = 0.1;
+// Perceptual targets of the Gaussian, for enlarging smooth images and
+// images with many edges
+const double SMOOTH_TARGET = 0.5;
+const double SHARP_TARGET = 0.6;
+// A better filter than the current one is only taken if it fits with this
+// margin, so that noise in the measurements does not make the choice flip
+const double UPGRADE_MARGIN = 0.8;
+// Timings in flight, as their results arrive a few frames later
+const size_t MAX_PENDING = 4;
+// Weight of a new measurement in the cost model
+const double SMOOTHING = 0.2;
+// Timings of less work than this (output pixels times taps) are mostly
+// overhead
+const double MIN_WORK = 1e5;
+
+const char* get_type_name(FilterType type) {
+    switch (type) {
+    case FilterType::BOX:
+        return "Box";
+    case FilterType::TENT:
+        return "Tent";
+    case FilterType::GAUSSIAN:
+        return "Gaussian";
+    case FilterType::LANCZOS:
+        return "Lanczos";
+    default:
+        return "Auto";
+    }
+}
+
+FilterChoice make_choice(FilterType type, double support = 0.0,
+                         double gaussian_sigma = 0.0) {
+    FilterChoice choice;
+    choice.type = type;
+    choice.support = support;
+    choice.gaussian_sigma = gaussian_sigma;
+    return choice;
+}
+
+// Average filter taps per output pixel
+double get_taps(const FilterChoice& filter, double texel_scale) {
+    double pixel_size = std::max(1.0 / texel_scale, 1.0);
+    double taps = std::max(2.0 * filter.get_width() * pixel_size, 1.0);
+    return taps * taps;
+}
+
+} // namespace
+
+double get_gaussian_sigma(double perceptual_target) {
+    // Adjust for a gamma of 0.42 (close to human perception)
+    double target = std::pow(perceptual_target, 1.0 / 0.42);
+    // Calculate sigma based on this frequency response at 0.5 Hz
+    return std::sqrt(2.0) * std::sqrt(-std::log(target)) / PI;
+}
+
+double FilterChoice::get_width() const {
+    switch (type) {
+    case FilterType::TENT:
+        return 1.0;
+    case FilterType::GAUSSIAN:
+        return gaussian_sigma * support;
+    case FilterType::LANCZOS:
+        return support;
+    default:
+        return 0.5;
+    }
+}
+
+std::string FilterChoice::get_name() const {
+    std::ostringstream name;
+    name << get_type_name(type);
+    if (type == FilterType::LANCZOS) {
+        name << support;
+    } else if (type == FilterType::GAUSSIAN) {
+        name << " (sigma " << gaussian_sigma << ", " << support
+             << " sigmas)";
+    }
+    return name.str();
+}
+
+FilterSelector::FilterSelector()
+    : budget_{DEFAULT_BUDGET},
+      timer_queries_{GLAD_GL_EXT_disjoint_timer_query != 0},
+      timing_{false}, costs_{}, samples_{} {
+    if (timer_queries_) {
+        queries_.resize(MAX_PENDING);
+        glGenQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+        check_for_gl_error();
+    } else {
+        std::cout << "No GPU timer queries: the Auto filter does not adapt "
+                     "to the frame time budget\n";
+    }
+}
+
+FilterSelector::~FilterSelector() {
+    for (const Timing& timing : pending_) {
+        queries_.push_back(timing.query);
+    }
+    if (!queries_.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(queries_.size()),
+                        queries_.data());
+    }
+}
+
+FilterChoice FilterSelector::choose(double texel_scale, double edge_density,
+                                    double pixels) {
+    // In steps, so that the sigma does not change with every band of the
+    // statistics
+    double sharpness = std::clamp(
+        (edge_density - FEW_EDGES) / (MANY_EDGES - FEW_EDGES), 0.0, 1.0);
+    sharpness = std::round(sharpness * 4.0) / 4.0;
+
+    // Best first
+    std::vector<FilterChoice> candidates;
+    if (texel_scale > 1.0) {
+        double sigma = get_gaussian_sigma(
+            SMOOTH_TARGET + (SHARP_TARGET - SMOOTH_TARGET) * sharpness);
+        candidates.push_back(make_choice(FilterType::GAUSSIAN, 4.0, sigma));
+        candidates.push_back(make_choice(FilterType::GAUSSIAN, 3.0, sigma));
+    } else {
+        if (edge_density >= FEW_EDGES) {
+            candidates.push_back(make_choice(FilterType::LANCZOS, 3.0));
+        }
+        candidates.push_back(make_choice(FilterType::LANCZOS, 2.0));
+        candidates.push_back(make_choice(
+            FilterType::GAUSSIAN, 3.0, get_gaussian_sigma(SMOOTH_TARGET)));
+    }
+    candidates.push_back(make_choice(FilterType::TENT));
+    candidates.push_back(make_choice(FilterType::BOX));
+    if (pixels <= 0.0) {
+        return candidates.front();
+    }
+
+    FilterChoice choice = candidates.back();
+    bool better = true; // Than the current choice
+    for (const FilterChoice& candidate : candidates) {
+        better = better && !(candidate == chosen_);
+        double limit = better ? budget_ * UPGRADE_MARGIN : budget_;
+        if (predict(candidate, texel_scale, pixels) <= limit) {
+            choice = candidate;
+            break;
+        }
+    }
+    if (choice == chosen_) {
+        return choice;
+    }
+    chosen_ = choice;
+    std::cout << "Auto filter: " << choice.get_name() << " (texel scale "
+              << texel_scale << ", edge density " << edge_density << ", "
+              << pixels / 1e6 << " megapixels, budget " << budget_
+              << " ms)\n  Predicted:";
+    for (const FilterChoice& candidate : candidates) {
+        std::cout << " " << candidate.get_name() << " "
+                  << predict(candidate, texel_scale, pixels) << " ms;";
+    }
+    std::cout << "\n";
+    return choice;
+}
+
+void FilterSelector::begin_timing() {
+    if (!timer_queries_) {
+        return;
+    }
+    collect();
+    if (queries_.empty()) {
+        return; // The GPU is behind, so this frame is not timed
+    }
+    pending_.push_back(Timing{queries_.back(), FilterType::AUTO, 0.0});
+    queries_.pop_back();
+    glBeginQuery(GL_TIME_ELAPSED_EXT, pending_.back().query);
+    timing_ = true;
+}
+
+void FilterSelector::end_timing(const FilterChoice& filter,
+                                double texel_scale, double pixels) {
+    if (!timing_) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+    pending_.back().type = filter.type;
+    pending_.back().work = pixels * get_taps(filter, texel_scale);
+    timing_ = false;
+}
+
+double FilterSelector::predict(const FilterChoice& filter,
+                               double texel_scale, double pixels) const {
+    // Filters that have not been measured are assumed to cost as much per
+    // tap as those that have, or nothing until something is measured
+    double cost = costs_[static_cast<int>(filter.type)];
+    if (samples_[static_cast<int>(filter.type)] == 0) {
+        double total = 0.0;
+        int measured = 0;
+        for (size_t i = 0; i < costs_.size(); i++) {
+            if (samples_[i] > 0) {
+                total += costs_[i];
+                measured++;
+            }
+        }
+        cost = measured > 0 ? total / measured : 0.0;
+    }
+    return pixels * get_taps(filter, texel_scale) * cost / 1e6;
+}
+
+void FilterSelector::collect() {
+    // Timings that span a disjoint event (like a change of GPU clocks) are
+    // meaningless
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    while (!pending_.empty()) {
+        const Timing& timing = pending_.front();
+        GLuint available = 0;
+        glGetQueryObjectuiv(timing.query, GL_QUERY_RESULT_AVAILABLE,
+                            &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64vEXT(timing.query, GL_QUERY_RESULT, &elapsed);
+        const int i = static_cast<int>(timing.type);
+        if (!disjoint && timing.work >= MIN_WORK) {
+            double cost = elapsed / timing.work;
+            costs_[i] = samples_[i] == 0
+                            ? cost
+                            : costs_[i] + (cost - costs_[i]) * SMOOTHING;
+            if (samples_[i]++ == 0) {
+                std::cout << "Measured cost of " << get_type_name(timing.type)
+                          << ": " << cost << " ns per output pixel and tap\n";
+            }
+        }
+        queries_.push_back(timing.query);
+        pending_.pop_front();
+    }
+    check_for_gl_error();
+}
+
+} // namespace imageviewer
@@ -0,0 +1,292 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/FrameDecoder.h>
+#include <cstdint>
+#include <cstring>
+#include <imageviewer/Png.h>
+#include <iostream>
+#include <stb_image.h>
+#include <stdexcept>
+#include <string>
+
+namespace imageviewer {
+
+namespace {
+
+uint16_t read_u16(const unsigned char* data) {
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+void append_u32(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+// One frame of an APNG, as described by its fcTL chunk
+struct ApngFrame {
+    int width;
+    int height;
+    int x;
+    int y;
+    int delay_ms;
+    unsigned char dispose_op;
+    unsigned char blend_op;
+    // Offset and size of the compressed data in IDAT or fdAT chunks
+    std::vector<std::pair<size_t, size_t>> data;
+};
+
+// The dispose_op and blend_op values of fcTL
+const unsigned char DISPOSE_NONE = 0;
+const unsigned char DISPOSE_PREVIOUS = 2;
+const unsigned char BLEND_SOURCE = 0;
+
+// Decodes APNG frames by turning each one into a standalone PNG for
+// stb_image, which only reads the default image, and then compositing it
+// onto the canvas
+class ApngDecoder : public FrameDecoder {
+  public:
+    ApngDecoder(std::vector<unsigned char> file, std::vector<ApngFrame> frames,
+                std::vector<unsigned char> header)
+        : file_{std::move(file)}, frames_{std::move(frames)},
+          header_{std::move(header)} {
+        width_ = static_cast<int>(read_be32(&header_[16]));
+        height_ = static_cast<int>(read_be32(&header_[20]));
+        rewind();
+    }
+
+    int get_width() const override { return width_; }
+
+    int get_height() const override { return height_; }
+
+    bool next_frame(Image& frame, int& delay_ms) override {
+        if (next_ >= frames_.size()) {
+            return false;
+        }
+        if (next_ > 0) {
+            dispose(frames_[next_ - 1]);
+        }
+        const ApngFrame& current = frames_[next_];
+        if (current.dispose_op == DISPOSE_PREVIOUS) {
+            saved_ = canvas_;
+        }
+        blend(current);
+
+        unsigned char* data = frame.get_data();
+        const size_t pixels = static_cast<size_t>(width_) * height_;
+        for (size_t i = 0; i < pixels; i++) {
+            data[i * 3 + 0] = canvas_[i * 4 + 0];
+            data[i * 3 + 1] = canvas_[i * 4 + 1];
+            data[i * 3 + 2] = canvas_[i * 4 + 2];
+        }
+        delay_ms = current.delay_ms;
+        next_++;
+        return true;
+    }
+
+    void rewind() override {
+        canvas_.assign(static_cast<size_t>(width_) * height_ * 4, 0);
+        saved_.clear();
+        next_ = 0;
+    }
+
+  private:
+    void dispose(const ApngFrame& previous) {
+        if (previous.dispose_op == DISPOSE_NONE) {
+            return;
+        }
+        for (int y = previous.y; y < previous.y + previous.height; y++) {
+            size_t offset = (static_cast<size_t>(y) * width_ + previous.x) * 4;
+            size_t size = static_cast<size_t>(previous.width) * 4;
+            if (previous.dispose_op == DISPOSE_PREVIOUS && !saved_.empty()) {
+                std::memcpy(&canvas_[offset], &saved_[offset], size);
+            } else {
+                // The first frame restores to the background as well
+                std::memset(&canvas_[offset], 0, size);
+            }
+        }
+    }
+
+    void blend(const ApngFrame& frame) {
+        std::vector<unsigned char> png = make_png(frame);
+        int width, height, channels;
+        unsigned char* pixels =
+            stbi_load_from_memory(png.data(), static_cast<int>(png.size()),
+                                  &width, &height, &channels, 4);
+        if (pixels == nullptr) {
+            throw std::runtime_error(std::string("Failed to decode APNG: ") +
+                                     stbi_failure_reason());
+        }
+        for (int y = 0; y < frame.height; y++) {
+            const unsigned char* src =
+                pixels + static_cast<size_t>(y) * frame.width * 4;
+            unsigned char* dst =
+                &canvas_[(static_cast<size_t>(frame.y + y) * width_ +
+                          frame.x) * 4];
+            if (frame.blend_op == BLEND_SOURCE) {
+                std::memcpy(dst, src, static_cast<size_t>(frame.width) * 4);
+                continue;
+            }
+            for (int x = 0; x < frame.width; x++, src += 4, dst += 4) {
+                if (src[3] == 255 || dst[3] == 0) {
+                    std::memcpy(dst, src, 4);
+                } else if (src[3] != 0) {
+                    // Source over destination, with straight alpha
+                    float src_a = src[3] / 255.0f;
+                    float dst_a = dst[3] / 255.0f * (1.0f - src_a);
+                    float a = src_a + dst_a;
+                    for (int c = 0; c < 3; c++) {
+                        dst[c] = static_cast<unsigned char>(
+                            (src[c] * src_a + dst[c] * dst_a) / a + 0.5f);
+                    }
+                    dst[3] = static_cast<unsigned char>(a * 255.0f + 0.5f);
+                }
+            }
+        }
+        stbi_image_free(pixels);
+    }
+
+    // A PNG with the frame's size and data, and the palette of the file
+    std::vector<unsigned char> make_png(const ApngFrame& frame) const {
+        size_t data_size = 0;
+        for (const auto& chunk : frame.data) {
+            data_size += chunk.second;
+        }
+        std::vector<unsigned char> png(header_);
+        png.reserve(png.size() + data_size + 24);
+        size_t ihdr = sizeof(PNG_SIGNATURE) + 8;
+        for (int i = 0; i < 4; i++) {
+            int shift = 24 - i * 8;
+            png[ihdr + i] = static_cast<unsigned char>(frame.width >> shift);
+            png[ihdr + 4 + i] =
+                static_cast<unsigned char>(frame.height >> shift);
+        }
+        // stb_image does not check the CRCs, so they are left as zero
+        append_u32(png, static_cast<uint32_t>(data_size));
+        png.insert(png.end(), {'I', 'D', 'A', 'T'});
+        for (const auto& chunk : frame.data) {
+            png.insert(png.end(), file_.begin() + chunk.first,
+                       file_.begin() + chunk.first + chunk.second);
+        }
+        append_u32(png, 0);
+        append_u32(png, 0);
+        png.insert(png.end(), {'I', 'E', 'N', 'D'});
+        append_u32(png, 0);
+        return png;
+    }
+
+    std::vector<unsigned char> file_;
+    std::vector<ApngFrame> frames_;
+    // Signature, IHDR and the chunks that all frames share (PLTE and tRNS)
+    std::vector<unsigned char> header_;
+    int width_;
+    int height_;
+    std::vector<unsigned char> canvas_;
+    std::vector<unsigned char> saved_;
+    size_t next_;
+};
+
+} // namespace
+
+std::unique_ptr<FrameDecoder>
+open_apng_decoder(std::vector<unsigned char>& file) {
+    if (file.size() < sizeof(PNG_SIGNATURE) ||
+        std::memcmp(file.data(), PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0) {
+        return nullptr;
+    }
+    std::vector<unsigned char> header(PNG_SIGNATURE,
+                                      PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+    std::vector<ApngFrame> frames;
+    bool animated = false;
+    int width = 0;
+    int height = 0;
+    size_t pos = sizeof(PNG_SIGNATURE);
+    while (pos + 12 <= file.size()) {
+        const size_t length = read_be32(&file[pos]);
+        const std::string type(file.begin() + pos + 4, file.begin() + pos + 8);
+        const size_t data = pos + 8;
+        const size_t end = data + length + 4;
+        if (end > file.size() || end < data) {
+            break; // Truncated file
+        }
+        if ((type == "IHDR" && length == 13) || type == "PLTE" ||
+            type == "tRNS") {
+            header.insert(header.end(), file.begin() + pos,
+                          file.begin() + end);
+            if (type == "IHDR") {
+                width = static_cast<int>(read_be32(&file[data]));
+                height = static_cast<int>(read_be32(&file[data + 4]));
+            }
+        } else if (type == "acTL") {
+            animated = true;
+        } else if (type == "fcTL" && length >= 26) {
+            ApngFrame frame;
+            frame.width = static_cast<int>(read_be32(&file[data + 4]));
+            frame.height = static_cast<int>(read_be32(&file[data + 8]));
+            frame.x = static_cast<int>(read_be32(&file[data + 12]));
+            frame.y = static_cast<int>(read_be32(&file[data + 16]));
+            int delay_num = read_u16(&file[data + 20]);
+            int delay_den = read_u16(&file[data + 22]);
+            if (delay_den == 0) {
+                delay_den = 100;
+            }
+            // Same minimum frame time as for GIF in web browsers
+            frame.delay_ms = delay_num * 1000 / delay_den;
+            if (frame.delay_ms <= 10) {
+                frame.delay_ms = 100;
+            }
+            frame.dispose_op = file[data + 24];
+            frame.blend_op = file[data + 25];
+            if (frame.width <= 0 || frame.height <= 0 || frame.x < 0 ||
+                frame.y < 0 ||
+                static_cast<int64_t>(frame.x) + frame.width > width ||
+                static_cast<int64_t>(frame.y) + frame.height > height) {
+                throw std::runtime_error("Invalid APNG frame");
+            }
+            frames.push_back(frame);
+        } else if (type == "IDAT" && !frames.empty()) {
+            // The default image is the first frame if it has a fcTL
+            frames.back().data.emplace_back(data, length);
+        } else if (type == "fdAT" && !frames.empty() && length > 4) {
+            frames.back().data.emplace_back(data + 4, length - 4);
+        } else if (type == "IEND") {
+            break;
+        }
+        pos = end;
+    }
+    while (!frames.empty() && frames.back().data.empty()) {
+        frames.pop_back(); // Truncated file
+    }
+    if (!animated || width == 0 || frames.size() < 2) {
+        return nullptr;
+    }
+    std::cout << "Animated PNG with " << frames.size() << " frames\n";
+    return std::make_unique<ApngDecoder>(std::move(file), std::move(frames),
+                                         std::move(header));
+}
+
+std::unique_ptr<FrameDecoder>
+open_frame_decoder(std::vector<unsigned char> file) {
+    std::unique_ptr<FrameDecoder> decoder = open_gif_decoder(file);
+    if (!decoder) {
+        decoder = open_apng_decoder(file);
+    }
+    return decoder;
+}
+
+} // namespace imageviewer
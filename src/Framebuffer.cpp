@@ -0,0 +1,113 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/Framebuffer.h>
+
+#include <cstring>
+#include <iostream>
+
+namespace imageviewer {
+
+Framebuffer::Framebuffer(int width, int height)
+    : framebuffer_{0}, renderbuffer_{0}, width_{width}, height_{height} {
+    glGenRenderbuffers(1, &renderbuffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+    check_for_gl_error();
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, renderbuffer_);
+    check_for_gl_error();
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Incomplete framebuffer");
+    }
+    std::cout << "Created framebuffer: " << width_ << " x " << height_ << "\n";
+}
+
+Framebuffer::Framebuffer(Framebuffer&& other) {
+    framebuffer_ = other.framebuffer_;
+    renderbuffer_ = other.renderbuffer_;
+    width_ = other.width_;
+    height_ = other.height_;
+    other.framebuffer_ = 0;
+    other.renderbuffer_ = 0;
+}
+
+Framebuffer& Framebuffer::operator=(Framebuffer&& other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (framebuffer_ != 0) {
+        glDeleteFramebuffers(1, &framebuffer_);
+    }
+    if (renderbuffer_ != 0) {
+        glDeleteRenderbuffers(1, &renderbuffer_);
+    }
+    framebuffer_ = other.framebuffer_;
+    renderbuffer_ = other.renderbuffer_;
+    width_ = other.width_;
+    height_ = other.height_;
+    other.framebuffer_ = 0;
+    other.renderbuffer_ = 0;
+    return *this;
+}
+
+Framebuffer::~Framebuffer() {
+    if (framebuffer_ != 0) {
+        glDeleteFramebuffers(1, &framebuffer_);
+    }
+    if (renderbuffer_ != 0) {
+        glDeleteRenderbuffers(1, &renderbuffer_);
+    }
+}
+
+void Framebuffer::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    check_for_gl_error();
+    glViewport(0, 0, width_, height_);
+}
+
+void Framebuffer::unbind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    check_for_gl_error();
+}
+
+std::vector<unsigned char> Framebuffer::read_pixels() {
+    // RGBA / UNSIGNED_BYTE is the only combination that is always supported
+    std::vector<unsigned char> rgba(static_cast<size_t>(width_) * height_ * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE,
+                 rgba.data());
+    check_for_gl_error();
+
+    // Drop alpha and flip, since OpenGL stores the bottom row first
+    std::vector<unsigned char> rgb(static_cast<size_t>(width_) * height_ * 3);
+    for (int y = 0; y < height_; y++) {
+        const unsigned char* src = &rgba[(height_ - 1 - y) * width_ * 4];
+        unsigned char* dst = &rgb[y * width_ * 3];
+        for (int x = 0; x < width_; x++) {
+            std::memcpy(dst + x * 3, src + x * 4, 3);
+        }
+    }
+    return rgb;
+}
+
+} // namespace imageviewer
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/FrameDecoder.h>
+#include <cstring>
+#include <imageviewer/GifFrames.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace imageviewer {
+
+namespace {
+
+size_t skip_sub_blocks(const std::vector<unsigned char>& file, size_t pos) {
+    while (pos < file.size() && file[pos] != 0) {
+        pos += file[pos] + 1;
+    }
+    return pos + 1;
+}
+
+// Counts the image descriptors in a GIF, without decoding them
+int count_gif_frames(const std::vector<unsigned char>& file, int limit) {
+    if (file.size() < 13 || std::memcmp(file.data(), "GIF8", 4) != 0) {
+        return 0;
+    }
+    size_t pos = 13;
+    if (file[10] & 0x80) {
+        pos += 3 * (2 << (file[10] & 7)); // Global color table
+    }
+    int frames = 0;
+    while (pos < file.size() && frames < limit) {
+        unsigned char block = file[pos++];
+        if (block == 0x2C) {
+            if (pos + 9 > file.size()) {
+                break;
+            }
+            unsigned char flags = file[pos + 8];
+            pos += 9;
+            if (flags & 0x80) {
+                pos += 3 * (2 << (flags & 7)); // Local color table
+            }
+            pos++; // LZW minimum code size
+            frames++;
+        } else if (block == 0x21) {
+            pos++; // Extension label
+        } else {
+            break; // Trailer or corrupt data
+        }
+        pos = skip_sub_blocks(file, pos);
+    }
+    return frames;
+}
+
+class GifDecoder : public FrameDecoder {
+  public:
+    explicit GifDecoder(std::vector<unsigned char> file)
+        : file_{std::move(file)}, frames_{file_.data(), file_.size()},
+          frame_count_{0} {
+        width_ = file_[6] | (file_[7] << 8);
+        height_ = file_[8] | (file_[9] << 8);
+    }
+
+    int get_width() const override { return width_; }
+
+    int get_height() const override { return height_; }
+
+    bool next_frame(Image& frame, int& delay_ms) override {
+        const unsigned char* two_back =
+            two_back_.empty() ? nullptr : two_back_.data();
+        const unsigned char* out;
+        try {
+            out = frames_.next_frame(two_back, delay_ms);
+        } catch (const std::runtime_error& e) {
+            if (frame_count_ == 0) {
+                throw std::runtime_error(
+                    std::string("Failed to decode GIF: ") + e.what());
+            }
+            // Play the frames up to the error, like web browsers do
+            std::cerr << "Truncated GIF: " << e.what() << "\n";
+            return false;
+        }
+        if (out == nullptr) {
+            return false; // End of the animation
+        }
+
+        // Disposal method 3 restores the frame before the previous one
+        const size_t pixels = static_cast<size_t>(width_) * height_;
+        std::swap(two_back_, previous_);
+        previous_.assign(out, out + pixels * 4);
+
+        unsigned char* data = frame.get_data();
+        for (size_t i = 0; i < pixels; i++) {
+            data[i * 3 + 0] = out[i * 4 + 0];
+            data[i * 3 + 1] = out[i * 4 + 1];
+            data[i * 3 + 2] = out[i * 4 + 2];
+        }
+        // Browsers show frames with (almost) no delay for 100 ms
+        delay_ms = delay_ms <= 10 ? 100 : delay_ms;
+        frame_count_++;
+        return true;
+    }
+
+    void rewind() override {
+        frames_.rewind();
+        previous_.clear();
+        two_back_.clear();
+        frame_count_ = 0;
+    }
+
+  private:
+    std::vector<unsigned char> file_;
+    GifFrames frames_;
+    int width_;
+    int height_;
+    std::vector<unsigned char> previous_;
+    std::vector<unsigned char> two_back_;
+    int frame_count_;
+};
+
+} // namespace
+
+std::unique_ptr<FrameDecoder>
+open_gif_decoder(std::vector<unsigned char>& file) {
+    if (count_gif_frames(file, 2) < 2) {
+        return nullptr;
+    }
+    return std::make_unique<GifDecoder>(std::move(file));
+}
+
+} // namespace imageviewer
@@ -0,0 +1,170 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/GoldenTest.h>
+
+#include <cmath>
+#include <config.h>
+#include <cstdio>
+#include <cstdlib>
+#include <imageviewer/Framebuffer.h>
+#include <imageviewer/ImageViewer.h>
+#include <imageviewer/ImageWriter.h>
+#include <imageviewer/TestPattern.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace imageviewer {
+
+namespace {
+
+const int OUTPUT_SIZE = 256;
+const int PATTERN_SIZE = 256;
+
+// Output may differ slightly between GPUs and drivers, but never by much
+const double MIN_PSNR = 40.0;
+const int MAX_ERROR = 8;
+
+const double SCALES[]{0.37, 1.0, 2.5};
+
+const FilterType FILTERS[]{FilterType::BOX, FilterType::TENT,
+                           FilterType::GAUSSIAN, FilterType::LANCZOS};
+
+struct Comparison {
+    double psnr;
+    int max_error;
+};
+
+const char* filter_file_name(FilterType filter_type) {
+    switch (filter_type) {
+    case FilterType::BOX:
+        return "box";
+    case FilterType::TENT:
+        return "tent";
+    case FilterType::GAUSSIAN:
+        return "gaussian";
+    case FilterType::LANCZOS:
+        return "lanczos3";
+    default:
+        return "auto";
+    }
+}
+
+std::string case_name(const std::string& image_name, FilterType filter_type,
+                      double scale) {
+    return image_name + "_" + filter_file_name(filter_type) + "_" +
+           std::to_string(static_cast<int>(std::round(scale * 100.0)));
+}
+
+Comparison compare(const std::vector<unsigned char>& actual,
+                   const Image& golden) {
+    double squared_error = 0.0;
+    int max_error = 0;
+    for (size_t i = 0; i < actual.size(); i++) {
+        int error = std::abs(actual[i] - golden.get_data()[i]);
+        squared_error += error * error;
+        max_error = std::max(max_error, error);
+    }
+    double mse = squared_error / actual.size();
+    double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+    return {psnr, max_error};
+}
+
+int run_case(ImageViewer& viewer, Framebuffer& framebuffer,
+             const std::string& golden_dir, const std::string& name,
+             bool update) {
+    framebuffer.bind();
+    viewer.render(0.0);
+    std::vector<unsigned char> pixels = framebuffer.read_pixels();
+    Framebuffer::unbind();
+
+    const std::string golden_file = golden_dir + "/" + name + ".png";
+    if (update) {
+        write_png(golden_file, OUTPUT_SIZE, OUTPUT_SIZE, pixels.data());
+        std::cout << "UPDATED " << name << "\n";
+        return 0;
+    }
+
+    int failed = 1;
+    try {
+        Image golden(golden_file);
+        if (golden.get_width() != OUTPUT_SIZE ||
+            golden.get_height() != OUTPUT_SIZE) {
+            std::cout << "FAIL " << name << ": golden image has wrong size\n";
+        } else {
+            Comparison result = compare(pixels, golden);
+            failed = result.psnr < MIN_PSNR || result.max_error > MAX_ERROR;
+            std::cout << (failed ? "FAIL " : "PASS ") << name
+                      << ": PSNR " << result.psnr << " dB, max error "
+                      << result.max_error << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cout << "FAIL " << name << ": " << e.what() << "\n";
+    }
+    if (failed) {
+        write_png(golden_dir + "/" + name + ".actual.png", OUTPUT_SIZE,
+                  OUTPUT_SIZE, pixels.data());
+    }
+    return failed;
+}
+
+int run_image_cases(GLFWwindow* window, Image image,
+                    const std::string& image_name,
+                    const std::string& golden_dir, bool update) {
+    Framebuffer framebuffer(OUTPUT_SIZE, OUTPUT_SIZE);
+    ImageViewer viewer(std::make_shared<const Image>(std::move(image)),
+                       window);
+    viewer.set_size(OUTPUT_SIZE, OUTPUT_SIZE);
+
+    int failures = 0;
+    for (double scale : SCALES) {
+        viewer.set_scale(scale);
+        for (FilterType filter_type : FILTERS) {
+            // Box is always used at 100%, so there's only one case to test
+            if (scale == 1.0 && filter_type != FilterType::BOX) {
+                continue;
+            }
+            viewer.set_filter_type(filter_type);
+            failures += run_case(viewer, framebuffer, golden_dir,
+                                 case_name(image_name, filter_type, scale),
+                                 update);
+        }
+    }
+    return failures;
+}
+
+} // namespace
+
+int run_golden_tests(GLFWwindow* window, const std::string& golden_dir,
+                     bool update) {
+    int failures = 0;
+    failures += run_image_cases(window, Image(DATA_DIR "checkerboard.png"),
+                                "checkerboard", golden_dir, update);
+    failures += run_image_cases(
+        window, make_test_pattern(TestPattern::ZONE_PLATE, PATTERN_SIZE),
+        "zoneplate", golden_dir, update);
+    failures += run_image_cases(
+        window, make_test_pattern(TestPattern::EDGES, PATTERN_SIZE), "edges",
+        golden_dir, update);
+    failures += run_image_cases(
+        window, make_test_pattern(TestPattern::GRADIENT, PATTERN_SIZE),
+        "gradient", golden_dir, update);
+    std::cout << "Golden image failures: " << failures << "\n";
+    return failures;
+}
+
+} // namespace imageviewer
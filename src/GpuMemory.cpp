@@ -0,0 +1,191 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <imageviewer/GpuMemory.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace imageviewer {
+
+namespace {
+
+const size_t DEFAULT_BUDGET = size_t(2) << 30;
+// From GL_NVX_gpu_memory_info, in kB
+const GLenum GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX = 0x9047;
+
+bool has_extension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const GLubyte* extension = glGetStringi(GL_EXTENSIONS, i);
+        if (extension != nullptr &&
+            std::strcmp(reinterpret_cast<const char*>(extension), name) ==
+                0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t get_default_budget() {
+    if (!has_extension("GL_NVX_gpu_memory_info")) {
+        return DEFAULT_BUDGET;
+    }
+    GLint kb = 0;
+    glGetIntegerv(GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &kb);
+    glGetError(); // In case the ES driver does not have it after all
+    return kb > 0 ? static_cast<size_t>(kb) * 1024 / 4 * 3 : DEFAULT_BUDGET;
+}
+
+double to_mb(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+} // namespace
+
+GpuMemory::GpuMemory()
+    : budget_{get_default_budget()}, resident_bytes_{0}, peak_bytes_{0},
+      frame_{0}, evictions_{0}, evicted_bytes_{0}, reduced_{0} {
+    std::cout << "GPU memory budget: " << to_mb(budget_) << " MB\n";
+}
+
+GpuMemory& GpuMemory::shared() {
+    static GpuMemory memory;
+    return memory;
+}
+
+void GpuMemory::set_budget(size_t bytes) {
+    budget_ = bytes;
+    std::cout << "GPU memory budget: " << to_mb(budget_) << " MB\n";
+    bool evicted = false;
+    while (resident_bytes_ > budget_ && evict_one()) {
+        evicted = true;
+    }
+    if (evicted) {
+        report("Evicted for the budget");
+    }
+}
+
+void GpuMemory::allocate(size_t bytes,
+                         const std::function<void()>& make_storage) {
+    bool evicted = false;
+    while (resident_bytes_ + bytes > budget_ && evict_one()) {
+        evicted = true;
+    }
+    if (evicted) {
+        report("Evicted for a new texture");
+    }
+    if (resident_bytes_ + bytes > budget_) {
+        throw GlOutOfMemory("Texture of " + std::to_string(bytes >> 20) +
+                            " MB is over the GPU memory budget");
+    }
+
+    // Earlier errors would be taken for errors from make_storage
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    make_storage();
+    GLenum error = glGetError();
+    // The driver may count differently, or have other uses for the memory
+    bool retried = false;
+    while (error == GL_OUT_OF_MEMORY && evict_one()) {
+        make_storage();
+        error = glGetError();
+        retried = true;
+    }
+    if (retried && error == GL_NO_ERROR) {
+        report("Evicted after running out of memory");
+    }
+    if (error != GL_NO_ERROR) {
+        if (error == GL_OUT_OF_MEMORY) {
+            throw GlOutOfMemory(get_gl_error_string(error));
+        }
+        throw std::runtime_error(get_gl_error_string(error));
+    }
+}
+
+void GpuMemory::add(GLuint texture, size_t bytes) {
+    allocations_[texture] = Allocation{bytes, frame_, nullptr};
+    resident_bytes_ += bytes;
+    peak_bytes_ = std::max(peak_bytes_, resident_bytes_);
+}
+
+void GpuMemory::remove(GLuint texture) {
+    auto it = allocations_.find(texture);
+    if (it != allocations_.end()) {
+        resident_bytes_ -= it->second.bytes;
+        allocations_.erase(it);
+    }
+}
+
+void GpuMemory::set_release(GLuint texture, std::function<void()> release) {
+    auto it = allocations_.find(texture);
+    if (it != allocations_.end()) {
+        it->second.release = std::move(release);
+    }
+}
+
+void GpuMemory::touch(GLuint texture) {
+    auto it = allocations_.find(texture);
+    if (it != allocations_.end()) {
+        it->second.last_frame = frame_;
+    }
+}
+
+void GpuMemory::report(const char* step, bool detailed) const {
+    size_t evictable = 0;
+    for (const auto& entry : allocations_) {
+        if (entry.second.release) {
+            evictable += entry.second.bytes;
+        }
+    }
+    std::cout << step << ". GPU memory: " << to_mb(resident_bytes_) << " of "
+              << to_mb(budget_) << " MB in " << allocations_.size()
+              << " textures (" << to_mb(evictable) << " MB evictable, peak "
+              << to_mb(peak_bytes_) << " MB), " << evictions_ << " evicted ("
+              << to_mb(evicted_bytes_) << " MB), " << reduced_
+              << " shown at reduced resolution\n";
+    if (!detailed) {
+        return;
+    }
+    for (const auto& entry : allocations_) {
+        std::cout << "  Texture " << entry.first << ": "
+                  << to_mb(entry.second.bytes) << " MB, drawn "
+                  << frame_ - entry.second.last_frame << " frames ago"
+                  << (entry.second.release ? ", evictable" : "") << "\n";
+    }
+}
+
+bool GpuMemory::evict_one() {
+    auto victim = allocations_.end();
+    for (auto it = allocations_.begin(); it != allocations_.end(); ++it) {
+        if (it->second.release && it->second.last_frame < frame_ &&
+            (victim == allocations_.end() ||
+             it->second.last_frame < victim->second.last_frame)) {
+            victim = it;
+        }
+    }
+    if (victim == allocations_.end()) {
+        return false;
+    }
+    evictions_++;
+    evicted_bytes_ += victim->second.bytes;
+    // The owner deletes the texture, which removes it
+    std::function<void()> release = std::move(victim->second.release);
+    release();
+    return true;
+}
+
+} // namespace imageviewer
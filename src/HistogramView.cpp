@@ -0,0 +1,86 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/HistogramView.h>
+
+#include <algorithm>
+#include <config.h>
+#include <vector>
+
+namespace imageviewer {
+
+namespace {
+
+// Size and distance from the window corner, in pixels
+const glm::dvec2 OVERLAY_SIZE(256.0, 100.0);
+const double OVERLAY_MARGIN = 10.0;
+
+} // namespace
+
+HistogramView::HistogramView() {
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    std::vector<float> empty(ImageStatistics::BINS * 4, 0.0f);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, ImageStatistics::BINS, 1, 0,
+                 GL_RGBA, GL_FLOAT, empty.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    check_for_gl_error();
+    shader_ = ShaderProgram(DATA_DIR "shaders/histogram_vert.glsl",
+                            DATA_DIR "shaders/histogram_frag.glsl");
+}
+
+HistogramView::~HistogramView() { glDeleteTextures(1, &texture_); }
+
+void HistogramView::update(const ImageStatistics::Result& result) {
+    // Clipped values often dwarf everything else, so they are left out of
+    // the scale and drawn at full height instead
+    uint64_t tallest = 1;
+    for (int c = 0; c < 3; c++) {
+        for (int i = 1; i < ImageStatistics::BINS - 1; i++) {
+            tallest = std::max(tallest, result.histograms[c][i]);
+        }
+    }
+    std::vector<float> heights(ImageStatistics::BINS * 4, 1.0f);
+    for (int i = 0; i < ImageStatistics::BINS; i++) {
+        for (int c = 0; c < 3; c++) {
+            heights[i * 4 + c] = std::min(
+                static_cast<float>(result.histograms[c][i]) / tallest, 1.0f);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ImageStatistics::BINS, 1,
+                    GL_RGBA, GL_FLOAT, heights.data());
+    check_for_gl_error();
+}
+
+void HistogramView::draw(SquareVertexArray& square, glm::dvec2 window_size) {
+    glm::dvec2 rect_min = 2.0 * OVERLAY_MARGIN / window_size - 1.0;
+    glm::dvec2 rect_max = rect_min + 2.0 * OVERLAY_SIZE / window_size;
+
+    shader_.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    shader_.set_uniform("histogram", 0);
+    shader_.set_uniform("rect_min", glm::vec2(rect_min));
+    shader_.set_uniform("rect_max", glm::vec2(rect_max));
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    square.render(shader_);
+    glDisable(GL_BLEND);
+}
+
+} // namespace imageviewer
@@ -15,22 +15,109 @@
  */
 
 #include <imageviewer/Image.h>
+#include <cstring>
+#include <fstream>
+#include <imageviewer/BufferPool.h>
+#include <imageviewer/ColorProfile.h>
+#include <imageviewer/GifFrames.h>
+#include <imageviewer/Orientation.h>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 
+// Decoded images are allocated from the buffer pool
+#define STBI_MALLOC(size) imageviewer::BufferPool::shared().allocate(size)
+#define STBI_REALLOC(data, size)                                           \
+    imageviewer::BufferPool::shared().reallocate(data, size)
+#define STBI_FREE(data) imageviewer::BufferPool::shared().release(data)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 namespace imageviewer {
 
+namespace {
+
+PooledBuffer load_file(const std::string& filename) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+    in.seekg(0, std::ios::end);
+    std::streamoff size = in.tellg();
+    if (size < 0) {
+        // Not seekable (like a pipe), so the size is not known in advance
+        in.clear();
+        std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)),
+                                        std::istreambuf_iterator<char>());
+        PooledBuffer file(data.size());
+        std::memcpy(file.get_data(), data.data(), data.size());
+        return file;
+    }
+    in.seekg(0);
+    PooledBuffer file(static_cast<size_t>(size));
+    if (!in.read(reinterpret_cast<char*>(file.get_data()), size)) {
+        throw std::runtime_error("Failed to read " + filename);
+    }
+    return file;
+}
+
+} // namespace
+
 Image::Image(const std::string& filename) {
     std::cout << "Loading " << filename << "...\n";
+    PooledBuffer file = load_file(filename);
+    decode(file.get_data(), file.get_size());
+}
+
+Image::Image(const unsigned char* data, size_t size) { decode(data, size); }
+
+Image::Image(int width, int height)
+    : width_{width}, height_{height}, exif_orientation_{1} {
+    // From the buffer pool like decoded images, for stbi_image_free
+    size_t size = static_cast<size_t>(width) * height * 3;
+    data_ = static_cast<unsigned char*>(BufferPool::shared().allocate(size));
+    if (data_ == nullptr) {
+        throw std::runtime_error("Failed to allocate image");
+    }
+    std::memset(data_, 0, size);
+}
+
+Image::Image(Image&& other) {
+    width_ = other.width_;
+    height_ = other.height_;
+    data_ = other.data_;
+    icc_profile_ = std::move(other.icc_profile_);
+    exif_orientation_ = other.exif_orientation_;
+    other.data_ = nullptr;
+}
+
+Image& Image::operator=(Image&& other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (data_ != nullptr) {
+        stbi_image_free(data_);
+    }
+    width_ = other.width_;
+    height_ = other.height_;
+    data_ = other.data_;
+    icc_profile_ = std::move(other.icc_profile_);
+    exif_orientation_ = other.exif_orientation_;
+    other.data_ = nullptr;
+    return *this;
+}
+
+void Image::decode(const unsigned char* data, size_t size) {
     int channels;
-    data_ = stbi_load(filename.c_str(), &width_, &height_, &channels, 3);
+    data_ = stbi_load_from_memory(data, static_cast<int>(size), &width_,
+                                  &height_, &channels, 3);
     if (data_ == 0) {
         throw std::runtime_error("Failed to load image");
     }
+    icc_profile_ = extract_icc_profile(data, size);
+    exif_orientation_ = extract_exif_orientation(data, size);
     std::cout << "Loaded image. Size: " << width_ << "x" << height_ << "\n";
+    BufferPool::shared().report("Loaded image");
 }
 
 Image::~Image() {
@@ -40,4 +127,43 @@ Image::~Image() {
     }
 }
 
+struct GifFrames::State {
+    stbi__context context;
+    stbi__gif gif;
+};
+
+GifFrames::GifFrames(const unsigned char* data, size_t size)
+    : data_{data}, size_{size}, state_{std::make_unique<State>()} {
+    std::memset(&state_->gif, 0, sizeof(state_->gif));
+    rewind();
+}
+
+GifFrames::~GifFrames() { free_buffers(); }
+
+const unsigned char* GifFrames::next_frame(const unsigned char* two_back,
+                                           int& delay_ms) {
+    int comp;
+    stbi_uc* out = stbi__gif_load_next(&state_->context, &state_->gif, &comp,
+                                       4, const_cast<stbi_uc*>(two_back));
+    if (out == reinterpret_cast<stbi_uc*>(&state_->context)) {
+        return nullptr; // End of the animation
+    } else if (out == nullptr) {
+        throw std::runtime_error(stbi_failure_reason());
+    }
+    delay_ms = state_->gif.delay;
+    return out;
+}
+
+void GifFrames::rewind() {
+    free_buffers();
+    std::memset(&state_->gif, 0, sizeof(state_->gif));
+    stbi__start_mem(&state_->context, data_, static_cast<int>(size_));
+}
+
+void GifFrames::free_buffers() {
+    STBI_FREE(state_->gif.out);
+    STBI_FREE(state_->gif.background);
+    STBI_FREE(state_->gif.history);
+}
+
 } // namespace imageviewer
@@ -0,0 +1,152 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/ImageStatistics.h>
+#include <algorithm>
+#include <cstdlib>
+#include <imageviewer/ThreadPool.h>
+#include <iostream>
+
+namespace imageviewer {
+
+namespace {
+
+// Rows per band, small enough that partial results arrive often
+const int BAND_ROWS = 64;
+
+// Difference in luma between neighbors that counts as an edge
+const int EDGE_THRESHOLD = 32;
+
+} // namespace
+
+int ImageStatistics::Result::get_min(int channel) const {
+    for (int i = 0; i < BINS; i++) {
+        if (histograms[channel][i] != 0) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+int ImageStatistics::Result::get_max(int channel) const {
+    for (int i = BINS - 1; i >= 0; i--) {
+        if (histograms[channel][i] != 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+ImageStatistics::ImageStatistics(std::shared_ptr<const Image> image)
+    : image_{std::move(image)}, version_{0}, cancelled_{false},
+      start_time_{std::chrono::steady_clock::now()} {
+    ThreadPool& pool = ThreadPool::shared();
+    for (int row = 0; row < image_->get_height(); row += BAND_ROWS) {
+        int rows = std::min(BAND_ROWS, image_->get_height() - row);
+        bands_.push_back(pool.submit([this, row, rows] {
+            if (!cancelled_) {
+                count_band(row, rows);
+            }
+        }));
+    }
+}
+
+ImageStatistics::~ImageStatistics() {
+    // The bands refer to this, so wait for the ones that have started
+    cancelled_ = true;
+    for (std::future<void>& band : bands_) {
+        band.wait();
+    }
+}
+
+ImageStatistics::Result ImageStatistics::get_result() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return result_;
+}
+
+bool ImageStatistics::is_complete() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return result_.pixels == get_total_pixels();
+}
+
+double ImageStatistics::get_edge_density() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return result_.pixels == 0
+               ? 0.0
+               : static_cast<double>(result_.edges) / result_.pixels;
+}
+
+void ImageStatistics::count_band(int first_row, int rows) {
+    // 32-bit counters keep the histograms in L1 cache (a band has far fewer
+    // than 2^32 pixels)
+    uint32_t histograms[3][BINS] = {};
+    uint64_t shadows = 0;
+    uint64_t highlights = 0;
+    uint64_t edges = 0;
+    const size_t width = static_cast<size_t>(image_->get_width());
+    const unsigned char* data =
+        image_->get_data() + static_cast<size_t>(first_row) * width * 3;
+    const size_t count = width * rows;
+    for (int row = 0; row < rows; row++) {
+        int last_luma = -1;
+        for (size_t x = 0; x < width; x++, data += 3) {
+            unsigned char r = data[0];
+            unsigned char g = data[1];
+            unsigned char b = data[2];
+            histograms[0][r]++;
+            histograms[1][g]++;
+            histograms[2][b]++;
+            shadows += std::min({r, g, b}) == 0;
+            highlights += std::max({r, g, b}) == 255;
+            int luma = (r * 77 + g * 150 + b * 29) >> 8;
+            edges += last_luma >= 0 &&
+                     std::abs(luma - last_luma) > EDGE_THRESHOLD;
+            last_luma = luma;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < BINS; i++) {
+            result_.histograms[c][i] += histograms[c][i];
+        }
+    }
+    result_.clipped_shadows += shadows;
+    result_.clipped_highlights += highlights;
+    result_.edges += edges;
+    result_.pixels += count;
+    version_++;
+
+    if (result_.pixels == get_total_pixels()) {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start_time_;
+        std::cout << "Image statistics (" << elapsed.count() * 1000.0
+                  << " ms):\n";
+        const char* names[] = {"Red", "Green", "Blue"};
+        for (int c = 0; c < 3; c++) {
+            std::cout << "  " << names[c] << ": " << result_.get_min(c)
+                      << " - " << result_.get_max(c) << "\n";
+        }
+        std::cout << "  Clipped shadows: " << result_.clipped_shadows
+                  << " pixels, highlights: " << result_.clipped_highlights
+                  << " pixels\n";
+        std::cout << "  Edge density: "
+                  << static_cast<double>(result_.edges) / result_.pixels
+                  << "\n";
+    }
+}
+
+} // namespace imageviewer
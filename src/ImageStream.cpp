@@ -0,0 +1,413 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <imageviewer/ImageStream.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <imageviewer/Png.h>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace imageviewer {
+
+namespace {
+
+const size_t READ_SIZE = 1 << 16;
+
+
+struct PnmHeader {
+    int width;
+    int height;
+    int channels;
+    int max_value;
+    size_t data_offset;
+};
+
+// Reads the next number of a PNM header, skipping whitespace and comments.
+// Returns false if the rest of it has not arrived yet.
+bool read_header_value(const unsigned char* data, size_t size, size_t& pos,
+                       int& value) {
+    while (pos < size && (std::isspace(data[pos]) || data[pos] == '#')) {
+        if (data[pos] == '#') {
+            while (pos < size && data[pos] != '\n') {
+                pos++;
+            }
+        } else {
+            pos++;
+        }
+    }
+    if (pos < size && !std::isdigit(data[pos])) {
+        throw std::runtime_error("Invalid PNM header");
+    }
+    long long number = 0;
+    while (pos < size && std::isdigit(data[pos]) && number <= 1 << 30) {
+        number = number * 10 + (data[pos++] - '0');
+    }
+    if (pos >= size) {
+        return false; // There may be more digits
+    }
+    if (number == 0 || number > 1 << 30) {
+        throw std::runtime_error("Invalid PNM header");
+    }
+    value = static_cast<int>(number);
+    return true;
+}
+
+// Reads the header of a binary PPM or PGM. Returns false if it is some
+// other format or the header has not arrived yet.
+bool read_pnm_header(const unsigned char* data, size_t size,
+                     PnmHeader& header) {
+    if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) {
+        return false;
+    }
+    size_t pos = 2;
+    if (!read_header_value(data, size, pos, header.width) ||
+        !read_header_value(data, size, pos, header.height) ||
+        !read_header_value(data, size, pos, header.max_value)) {
+        return false;
+    }
+    if (!std::isspace(data[pos]) || header.max_value > 65535) {
+        throw std::runtime_error("Invalid PNM header");
+    }
+    header.channels = data[1] == '6' ? 3 : 1;
+    header.data_offset = pos + 1; // A single whitespace character
+    return true;
+}
+
+int open_source(const std::string& source) {
+    if (source == "-") {
+        return STDIN_FILENO;
+    }
+    if (source.rfind("unix:", 0) == 0) {
+        std::string path = source.substr(5);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Socket path too long: " + path);
+        }
+        std::strcpy(address.sun_path, path.c_str());
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to create a socket");
+        }
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                    sizeof(address)) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to connect to " + path);
+        }
+        return fd;
+    }
+    // Opened for writing too, so that it does not block until there is a
+    // writer, and does not end when a writer is done. One writer after
+    // another can send images.
+    int fd = open(source.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + source);
+    }
+    return fd;
+}
+
+} // namespace
+
+bool ImageStream::is_stream(const std::string& source) {
+    struct stat file_stat;
+    return source == "-" || source.rfind("unix:", 0) == 0 ||
+           (stat(source.c_str(), &file_stat) == 0 &&
+            S_ISFIFO(file_stat.st_mode));
+}
+
+ImageStream::ImageStream(const std::string& source,
+                         std::function<void()> on_change)
+    : source_{source}, on_change_{std::move(on_change)},
+      fd_{open_source(source)}, update_{nullptr, 0, false}, changed_{false} {
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+        if (fd_ != STDIN_FILENO) {
+            close(fd_);
+        }
+        throw std::runtime_error("Failed to create eventfd");
+    }
+    thread_ = std::thread(&ImageStream::run, this);
+    std::cout << "Reading images from " << source << "\n";
+}
+
+ImageStream::~ImageStream() {
+    uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) != sizeof(one)) {
+        std::cerr << "Failed to stop reading the stream\n";
+    }
+    thread_.join();
+    close(stop_fd_);
+    if (fd_ != STDIN_FILENO) {
+        close(fd_);
+    }
+}
+
+bool ImageStream::take_update(Update& update) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!changed_) {
+        return false;
+    }
+    update = update_;
+    changed_ = false;
+    return true;
+}
+
+void ImageStream::run() {
+    std::vector<unsigned char> buffer;
+    while (true) {
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        int ready = poll(fds, 2, -1);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        } else if (ready < 0 || fds[1].revents != 0) {
+            return;
+        }
+        size_t size = buffer.size();
+        buffer.resize(size + READ_SIZE);
+        ssize_t length = read(fd_, buffer.data() + size, READ_SIZE);
+        buffer.resize(size + std::max<ssize_t>(length, 0));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        } else if (length <= 0) {
+            std::cout << "End of " << source_ << "\n";
+            if (!buffer.empty()) {
+                std::cerr << "Incomplete image at the end of " << source_
+                          << "\n";
+            }
+            return;
+        }
+        try {
+            // There may be several images in what was read
+            while (size_t end = decode(buffer)) {
+                buffer.erase(buffer.begin(), buffer.begin() + end);
+                progress_ = Progress();
+            }
+        } catch (const std::exception& e) {
+            // Where the next image starts is unknown
+            std::cerr << "Stopped reading " << source_ << ": " << e.what()
+                      << "\n";
+            return;
+        }
+    }
+}
+
+size_t ImageStream::decode(const std::vector<unsigned char>& buffer) {
+    const unsigned char* data = buffer.data();
+    PnmHeader pnm;
+    if (read_pnm_header(data, buffer.size(), pnm) && pnm.max_value == 255) {
+        // Converted to RGB rows as they arrive. The rows that have been
+        // published are left alone, since they are being shown.
+        if (!progress_.partial) {
+            progress_.partial = std::make_shared<Image>(pnm.width, pnm.height);
+            publish(progress_.partial, 0, false);
+        }
+        size_t row_size = static_cast<size_t>(pnm.width) * pnm.channels;
+        size_t rows = (buffer.size() - pnm.data_offset) / row_size;
+        int available = static_cast<int>(
+            std::min(rows, static_cast<size_t>(pnm.height)));
+        for (int y = progress_.partial_rows; y < available; y++) {
+            const unsigned char* in = data + pnm.data_offset + y * row_size;
+            unsigned char* out = progress_.partial->get_data() +
+                                 static_cast<size_t>(y) * pnm.width * 3;
+            for (int x = 0; x < pnm.width; x++) {
+                for (int c = 0; c < 3; c++) {
+                    out[x * 3 + c] = in[x * pnm.channels +
+                                        (pnm.channels == 3 ? c : 0)];
+                }
+            }
+        }
+        if (available > progress_.partial_rows) {
+            progress_.partial_rows = available;
+            publish(progress_.partial, available, available == pnm.height);
+        }
+        if (available < pnm.height) {
+            return 0;
+        }
+        return pnm.data_offset + row_size * pnm.height;
+    }
+
+    size_t end = find_image_end(data, buffer.size());
+    if (end == 0) {
+        show_preview(data, buffer.size());
+        return 0;
+    }
+    try {
+        auto image = std::make_shared<const Image>(data, end);
+        publish(image, image->get_height(), true);
+    } catch (const std::exception& e) {
+        std::cerr << "Skipping an image from " << source_ << ": " << e.what()
+                  << "\n";
+    }
+    return end;
+}
+
+void ImageStream::show_preview(const unsigned char* data, size_t size) {
+    if (progress_.preview_failed) {
+        return;
+    }
+    try {
+        if (std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0) {
+            if (!progress_.png) {
+                progress_.png = std::make_unique<ProgressivePng>();
+            }
+            ProgressivePng& png = *progress_.png;
+            if (!png.update(data, size)) {
+                return;
+            }
+            const Image& image = *png.get_image();
+            if (!png.is_interlaced()) {
+                publish(png.get_image(), png.get_rows(), false);
+                return;
+            }
+            // The next pass is drawn over this one, so a copy is shown
+            auto copy = std::make_shared<Image>(image.get_width(),
+                                                image.get_height());
+            std::memcpy(copy->get_data(), image.get_data(),
+                        static_cast<size_t>(image.get_width()) *
+                            image.get_height() * 3);
+            publish(copy, copy->get_height(), false);
+        } else if (progress_.progressive &&
+                   progress_.scans > progress_.shown_scans) {
+            // Decoded as if the file ended after the scans so far, which
+            // leaves out the detail that the later scans add
+            std::vector<unsigned char> scans(data, data + progress_.scans_end);
+            scans.push_back(0xff);
+            scans.push_back(0xd9);
+            auto image =
+                std::make_shared<const Image>(scans.data(), scans.size());
+            progress_.shown_scans = progress_.scans;
+            publish(image, image->get_height(), false);
+        }
+    } catch (const std::exception& e) {
+        // Shown once all of it has arrived instead
+        std::cerr << "No preview of the image arriving from " << source_
+                  << ": " << e.what() << "\n";
+        progress_.preview_failed = true;
+    }
+}
+
+size_t ImageStream::find_image_end(const unsigned char* data, size_t size) {
+    PnmHeader pnm;
+    if (size < sizeof(PNG_SIGNATURE)) {
+        return 0;
+    } else if (std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0) {
+        return find_png_end(data, size);
+    } else if (data[0] == 0xff && data[1] == 0xd8) {
+        return find_jpeg_end(data, size);
+    } else if (data[0] == 'B' && data[1] == 'M') {
+        size_t end = data[2] | data[3] << 8 | data[4] << 16 |
+                     static_cast<size_t>(data[5]) << 24;
+        if (end < 14) {
+            throw std::runtime_error("Invalid BMP header");
+        }
+        return end <= size ? end : 0;
+    } else if (read_pnm_header(data, size, pnm)) {
+        size_t end = pnm.data_offset +
+                     static_cast<size_t>(pnm.width) * pnm.height *
+                         pnm.channels * (pnm.max_value > 255 ? 2 : 1);
+        return end <= size ? end : 0;
+    } else if (data[0] == 'P' && (data[1] == '5' || data[1] == '6')) {
+        return 0; // The rest of the header is on its way
+    }
+    // Only formats that tell where they end can be told apart from the
+    // images that follow
+    throw std::runtime_error("Unsupported image format");
+}
+
+size_t ImageStream::find_png_end(const unsigned char* data, size_t size) {
+    size_t& pos = progress_.position;
+    pos = std::max(pos, sizeof(PNG_SIGNATURE));
+    while (pos + 8 <= size) {
+        size_t next = pos + 12 + read_be32(data + pos);
+        if (std::memcmp(data + pos + 4, "IEND", 4) == 0) {
+            return next <= size ? next : 0;
+        }
+        pos = next;
+    }
+    return 0;
+}
+
+// Follows the segments, and the entropy coded data of each scan, to the end
+// of image marker. Thumbnails in the EXIF data are skipped with their
+// segment.
+size_t ImageStream::find_jpeg_end(const unsigned char* data, size_t size) {
+    size_t& pos = progress_.position;
+    pos = std::max(pos, size_t{2});
+    while (true) {
+        if (progress_.entropy_coded) {
+            // Until a marker, other than a restart marker (0xff 0x00 is a
+            // 0xff byte of the data)
+            while (pos + 1 < size &&
+                   (data[pos] != 0xff || data[pos + 1] == 0x00 ||
+                    (data[pos + 1] >= 0xd0 && data[pos + 1] <= 0xd7))) {
+                pos++;
+            }
+            if (pos + 1 >= size) {
+                return 0;
+            }
+            progress_.entropy_coded = false;
+            progress_.scans++;
+            progress_.scans_end = pos;
+        }
+        if (pos + 2 > size) {
+            return 0;
+        }
+        if (data[pos] != 0xff) {
+            throw std::runtime_error("Invalid JPEG data");
+        }
+        int marker = data[pos + 1];
+        if (marker == 0xff) {
+            pos++; // Fill byte
+        } else if (marker == 0xd9) {
+            return pos + 2;
+        } else if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {
+            pos += 2; // No length
+        } else if (pos + 4 > size) {
+            return 0;
+        } else {
+            if (marker == 0xc2) {
+                progress_.progressive = true;
+            }
+            progress_.entropy_coded = marker == 0xda; // Start of scan
+            pos += 2 + (data[pos + 2] << 8 | data[pos + 3]);
+        }
+    }
+}
+
+void ImageStream::publish(std::shared_ptr<const Image> image, int rows,
+                          bool complete) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        update_.image = std::move(image);
+        update_.rows = rows;
+        update_.complete = complete;
+        changed_ = true;
+    }
+    on_change_();
+}
+
+} // namespace imageviewer
@@ -18,10 +18,18 @@
 
 #include <cmath>
 #include <config.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <glm/common.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/scalar_common.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/matrix.hpp>
+#include <imageviewer/GpuMemory.h>
 #include <imageviewer/Image.h>
+#include <imageviewer/StartupTrace.h>
+#include <imageviewer/ThreadPool.h>
 #include <imageviewer/glfw.h>
 #include <iostream>
 
@@ -29,74 +37,615 @@ namespace imageviewer {
 
 namespace {
 
-const double PI = 3.14159265358979;
+// Largest side of the preview of an image that is decoded by region
+const int PREVIEW_SIZE = 4096;
+
+// Size of the tiles that are compared and uploaded again on reload
+const int RELOAD_TILE_SIZE = 128;
+
+// Tiles of an export drawn per frame, which keeps the viewer responsive
+const int EXPORT_TILES_PER_FRAME = 2;
+
+// Images that do not fit in GPU memory are halved until they do, down to
+// this size
+const int MIN_REDUCED_SIZE = 256;
+
+// Filter number of the first kernel from kernels.txt in the shader
+const int FILTER_KERNEL = 5;
 
 double calc_gaussian_sigma() {
     // Frequency response of perceptual brightness at half sampling frequency
     double gauss_target_perceptual = 0.5;
-    // Adjust for a gamma of 0.42 (close to human perception)
-    double gauss_target = std::pow(gauss_target_perceptual, 1.0 / 0.42);
-    // Calculate sigma based on this frequency response at 0.5 Hz
-    double sigma = std::sqrt(2.0) * std::sqrt(-std::log(gauss_target)) / PI;
+    double sigma = get_gaussian_sigma(gauss_target_perceptual);
 
     std::cout << "Gaussian target frequency response (perceptual) at 0.5 Hz: "
               << gauss_target_perceptual << "\n";
-    std::cout << "Gaussian target response (gamma adjusted): " << gauss_target
-              << "\n";
     std::cout << "Gaussian sigma: " << sigma << "\n";
 
     return sigma;
 }
 
+FilterKernels load_kernels() {
+    try {
+        return FilterKernels(DATA_DIR "shaders/kernels.txt");
+    } catch (const std::exception& e) {
+        std::cerr << "No filter kernels: " << e.what() << "\n";
+        return FilterKernels();
+    }
+}
+
+ColorProfile get_source_profile(const Image& image) {
+    if (image.get_icc_profile().empty()) {
+        return ColorProfile();
+    }
+    try {
+        return ColorProfile::from_icc(image.get_icc_profile());
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring embedded color profile: " << e.what() << "\n";
+        return ColorProfile();
+    }
+}
+
+// Rectangles of the tiles that differ between two images of the same size.
+// Changed tiles next to each other on a row are merged.
+std::vector<glm::ivec4> find_changed_tiles(const Image& old_image,
+                                           const Image& image) {
+    std::vector<glm::ivec4> changes;
+    int width = image.get_width();
+    int height = image.get_height();
+    size_t row_size = static_cast<size_t>(width) * 3;
+    for (int y = 0; y < height; y += RELOAD_TILE_SIZE) {
+        int tile_height = std::min(RELOAD_TILE_SIZE, height - y);
+        int start = -1; // Of the changed tiles so far
+        for (int x = 0; x < width + RELOAD_TILE_SIZE; x += RELOAD_TILE_SIZE) {
+            bool changed = false;
+            int tile_width = std::min(RELOAD_TILE_SIZE, width - x);
+            for (int row = y; row < y + tile_height && tile_width > 0; row++) {
+                size_t offset = row * row_size + static_cast<size_t>(x) * 3;
+                if (std::memcmp(old_image.get_data() + offset,
+                                image.get_data() + offset,
+                                static_cast<size_t>(tile_width) * 3) != 0) {
+                    changed = true;
+                    break;
+                }
+            }
+            if (changed && start < 0) {
+                start = x;
+            } else if (!changed && start >= 0) {
+                changes.emplace_back(start, y, std::min(x, width) - start,
+                                     tile_height);
+                start = -1;
+            }
+        }
+    }
+    return changes;
+}
+
+// Half the size (rounded up), averaging each 2 x 2 block of pixels
+Image halve(const Image& image) {
+    const int width = image.get_width();
+    const int height = image.get_height();
+    Image half((width + 1) / 2, (height + 1) / 2);
+    const int half_width = half.get_width();
+    ThreadPool::shared().parallel_for(half.get_height(), [&](size_t row) {
+        const int y = static_cast<int>(row) * 2;
+        const unsigned char* top =
+            image.get_data() + static_cast<size_t>(y) * width * 3;
+        const unsigned char* bottom =
+            image.get_data() +
+            static_cast<size_t>(std::min(y + 1, height - 1)) * width * 3;
+        unsigned char* out = half.get_data() + row * half_width * 3;
+        for (int x = 0; x < half_width; x++) {
+            const int left = x * 6;
+            const int right = std::min(x * 2 + 1, width - 1) * 3;
+            for (int c = 0; c < 3; c++) {
+                out[x * 3 + c] = static_cast<unsigned char>(
+                    (top[left + c] + top[right + c] + bottom[left + c] +
+                     bottom[right + c] + 2) /
+                    4);
+            }
+        }
+    });
+    return half;
+}
+
+// Name for an export of the view in the current directory, which does not
+// replace an earlier one
+std::string get_export_filename(const std::string& image_filename,
+                                glm::ivec2 size) {
+    std::string stem = image_filename.empty()
+                           ? "view"
+                           : std::filesystem::path(image_filename)
+                                 .stem()
+                                 .string();
+    std::string base = stem + "-" + std::to_string(size.x) + "x" +
+                       std::to_string(size.y);
+    std::string filename = base + ".png";
+    for (int i = 2; std::filesystem::exists(filename); i++) {
+        filename = base + "-" + std::to_string(i) + ".png";
+    }
+    return filename;
+}
+
 } // namespace
 
+LoadedImage load_image(const std::string& filename) {
+    LoadedImage loaded;
+    loaded.filename = filename;
+    if (ImageStream::is_stream(filename)) {
+        // Black until the first image arrives
+        loaded.image = std::make_shared<const Image>(1, 1);
+        return loaded;
+    }
+    loaded.tiled_image = TiledImage::open(filename);
+    if (loaded.tiled_image) {
+        loaded.image = loaded.tiled_image->make_preview(PREVIEW_SIZE);
+        trace_startup("Made the preview");
+    } else {
+        loaded.image = std::make_shared<const Image>(filename);
+        trace_startup("Decoded the image");
+    }
+    return loaded;
+}
+
+std::future<LoadedImage> load_image_async(const std::string& filename) {
+    // Not on the thread pool, since making a preview waits for pool tasks
+    return std::async(std::launch::async,
+                      [filename] { return load_image(filename); });
+}
+
 ImageViewer::ImageViewer(const std::string& image_filename, GLFWwindow* window)
-    : window_{window}, mouse_down_{false}, scale_{1.0}, translate_{0.0f},
-      srgb_enabled_{true}, filter_type_{FilterType::AUTO}, best_fit_{true},
+    : ImageViewer(window) {
+    open(load_image(image_filename));
+}
+
+ImageViewer::ImageViewer(std::future<LoadedImage> loading, GLFWwindow* window)
+    : ImageViewer(window) {
+    open(loading.get());
+}
+
+ImageViewer::ImageViewer(std::shared_ptr<const Image> image,
+                         GLFWwindow* window)
+    : ImageViewer(window) {
+    LoadedImage loaded;
+    loaded.image = std::move(image);
+    open(std::move(loaded));
+}
+
+ImageViewer::ImageViewer(GLFWwindow* window)
+    : window_{window}, compressed_{false}, stream_rows_{0},
+      stream_complete_{false}, histogram_version_{-1}, inspector_{false},
+      kernels_{load_kernels()}, kernel_{-1}, drawn_texel_scale_{1.0},
+      drawn_pixels_{0.0}, export_texel_scale_{1.0}, export_scale_{4.0},
+      mouse_down_{false}, scale_{1.0}, translate_{0.0f}, srgb_enabled_{true},
+      filter_type_{FilterType::AUTO}, best_fit_{true},
       gaussian_sigma_{calc_gaussian_sigma()} {
-    // TODO: this assumes that the image fits in a single texture
-    texture_ = Texture(Image(image_filename));
-    image_size_ = glm::dvec2(texture_.get_width(), texture_.get_height());
     shader_ = ShaderProgram(DATA_DIR "shaders/vert.glsl",
-                            DATA_DIR "shaders/frag.glsl");
+                            DATA_DIR "shaders/frag.glsl",
+                            kernels_.get_shader_sources());
+    trace_startup("Compiled the shaders");
+    try {
+        shader_watcher_ = std::make_unique<FileWatcher>(
+            DATA_DIR "shaders/", [] { glfwPostEmptyEvent(); });
+    } catch (const std::exception& e) {
+        std::cerr << "Not watching the shaders: " << e.what() << "\n";
+    }
+}
+
+void ImageViewer::open(LoadedImage loaded) {
+    image_ = std::move(loaded.image);
+    filename_ = loaded.filename;
+    image_size_ = glm::dvec2(image_->get_width(), image_->get_height());
+    statistics_ = std::make_unique<ImageStatistics>(image_);
+    orientation_ = Orientation::from_exif(image_->get_exif_orientation());
+    if (!orientation_.is_identity()) {
+        std::cout << "EXIF orientation: " << orientation_.get_description()
+                  << "\n";
+    }
+    source_profile_ = get_source_profile(*image_);
+    color_transform_ = ColorTransform(source_profile_, ColorProfile());
+
+    if (loaded.tiled_image) {
+        // The preview stands in for the image, which keeps its full size
+        image_size_ = glm::dvec2(loaded.tiled_image->get_width(),
+                                 loaded.tiled_image->get_height());
+        detail_ = std::make_unique<DetailView>(std::move(loaded.tiled_image));
+    } else if (ImageStream::is_stream(filename_)) {
+        stream_ = std::make_unique<ImageStream>(
+            filename_, [] { glfwPostEmptyEvent(); });
+    } else if (!filename_.empty()) {
+        animation_ = Animation::open(filename_);
+    }
+    if (!filename_.empty() && !detail_ && !animation_ && !stream_) {
+        try {
+            watcher_ = std::make_unique<FileWatcher>(
+                filename_, [] { glfwPostEmptyEvent(); });
+        } catch (const std::exception& e) {
+            std::cerr << "Not watching for changes: " << e.what() << "\n";
+        }
+    }
+    texture_ = upload_image();
+    trace_startup("Uploaded the image");
     update_window_title();
 }
 
+ImageViewer::~ImageViewer() {
+    if (reloading_.valid()) {
+        reloading_.wait(); // It uses the viewer
+    }
+}
+
 void ImageViewer::render(double time_delta) {
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glm::dmat4 transform_pos(1.0);
-    transform_pos =
-        glm::scale(transform_pos, glm::dvec3(2.0 * scale_ / window_size_, 1.0));
-    transform_pos = glm::translate(transform_pos, glm::dvec3(translate_, 0.0));
-    transform_pos =
-        glm::scale(transform_pos, glm::dvec3(image_size_ / 2.0, 1.0));
+    if (animation_) {
+        animation_->update(time_delta);
+    }
+    check_for_reload();
+    check_for_stream();
+    check_for_shader_reload();
 
-    float pixel_size = std::max(1.0 / scale_, 1.0);
-    float gaussian_a = 1.0 / (2.0 * gaussian_sigma_ * gaussian_sigma_);
+    glm::dmat4 transform_pos = get_transform_pos();
+    if (detail_) {
+        update_detail(transform_pos);
+    }
+    glm::dvec2 drawn_size = glm::min(
+        orientation_.apply_to_size(image_size_) * scale_, window_size_);
+    drawn_pixels_ = drawn_size.x * drawn_size.y;
+    // Only the simple case is timed, for the cost model of the filters
+    const bool timed = !compare_ && !detail_ && kernel_ < 0;
+    if (timed) {
+        // Any upload happens here, so that it is not counted as filtering
+        get_resident_texture();
+        filter_selector_.begin_timing();
+    }
+    draw_view(transform_pos, scale_, glm::dmat4(1.0));
+    if (timed) {
+        filter_selector_.end_timing(drawn_filter_, drawn_texel_scale_,
+                                    drawn_pixels_);
+    }
+
+    if (histogram_view_) {
+        draw_histogram();
+    }
+    if (export_) {
+        continue_export();
+    }
+}
+
+void ImageViewer::check_for_reload() {
+    if (reloading_.valid()) {
+        if (reloading_.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+            return;
+        }
+        reloading_.get();
+        if (reloaded_) {
+            apply_reload();
+        }
+    }
+    if (!watcher_ || !watcher_->take_change()) {
+        return;
+    }
 
-    FilterType filter_type = filter_type_;
-    if (std::fabs(scale_ - 1.0) < 0.000001) {
-        filter_type = FilterType::BOX; // box when no scaling
-    } else if (filter_type == FilterType::AUTO && scale_ > 1.0) {
-        filter_type = FilterType::GAUSSIAN; // Gaussian for auto enlargement
-    } else if (filter_type == FilterType::AUTO) {
-        filter_type = FilterType::LANCZOS; // Lanczos3 for auto downscaling
+    // Decode and compare in the background, keeping the current image until
+    // the new one is ready
+    reload_start_ = std::chrono::steady_clock::now();
+    std::shared_ptr<const Image> current = image_;
+    reloading_ = ThreadPool::shared().submit([this, current] {
+        try {
+            auto image = std::make_shared<const Image>(filename_);
+            reloaded_changes_.clear();
+            if (image->get_width() == current->get_width() &&
+                image->get_height() == current->get_height()) {
+                reloaded_changes_ = find_changed_tiles(*current, *image);
+            }
+            reloaded_ = std::move(image);
+        } catch (const std::exception& e) {
+            // Most likely caught in the middle of being written. The next
+            // change is picked up when the writer is done.
+            std::cerr << "Failed to reload " << filename_ << ": " << e.what()
+                      << "\n";
+        }
+    });
+}
+
+void ImageViewer::apply_reload() {
+    std::shared_ptr<const Image> image = std::move(reloaded_);
+    bool same_size = image->get_width() == image_->get_width() &&
+                     image->get_height() == image_->get_height();
+    if (same_size && reloaded_changes_.empty()) {
+        std::cout << "Reloaded " << filename_ << ": unchanged\n";
+        return;
+    }
+
+    // Only upload the tiles that changed, if the size stays the same
+    if (same_size && texture_.is_valid() &&
+        texture_.get_width() == image->get_width()) {
+        size_t pixels = 0;
+        for (const glm::ivec4& rect : reloaded_changes_) {
+            texture_.update(*image, rect.x, rect.y, rect.z, rect.w);
+            pixels += static_cast<size_t>(rect.z) * rect.w;
+        }
+        std::cout << "Uploaded " << reloaded_changes_.size()
+                  << " changed regions ("
+                  << 100.0 * pixels / image->get_width() / image->get_height()
+                  << "% of the image)\n";
+    } else {
+        texture_ = Texture();
     }
+    compressed_texture_ = Texture();
+    if (image->get_icc_profile() != image_->get_icc_profile()) {
+        source_profile_ = get_source_profile(*image);
+        color_transform_ = ColorTransform(source_profile_, display_profile_);
+    }
+    image_ = std::move(image);
+    statistics_ = std::make_unique<ImageStatistics>(image_);
+    histogram_version_ = -1;
+    if (!same_size) {
+        image_size_ = glm::dvec2(image_->get_width(), image_->get_height());
+        if (best_fit_) {
+            calc_best_fit();
+        }
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - reload_start_;
+    std::cout << "Reloaded " << filename_ << " (" << elapsed.count()
+              << " ms)\n";
+    update_window_title();
+}
 
+void ImageViewer::check_for_shader_reload() {
+    if (!shader_watcher_ || !shader_watcher_->take_change()) {
+        return;
+    }
+    // Everything is built before anything is replaced, so that mistakes in
+    // the files being edited leave the current shaders running
+    try {
+        FilterKernels kernels(DATA_DIR "shaders/kernels.txt");
+        GeneratedSources sources = kernels.get_shader_sources();
+        ShaderProgram shader(DATA_DIR "shaders/vert.glsl",
+                             DATA_DIR "shaders/frag.glsl", sources);
+        if (compare_) {
+            compare_->reload_shader(sources);
+        }
+        shader_ = std::move(shader);
+        kernels_ = std::move(kernels);
+    } catch (const std::exception& e) {
+        std::cerr << "Keeping the current shaders: " << e.what() << "\n";
+        return;
+    }
+    if (kernel_ >= kernels_.get_count()) {
+        kernel_ = -1;
+    }
+    std::cout << "Reloaded the shaders\n";
+    update_window_title();
+}
+
+void ImageViewer::check_for_stream() {
+    ImageStream::Update update;
+    if (!stream_ || !stream_->take_update(update)) {
+        return;
+    }
+    int width = update.image->get_width();
+    int height = update.image->get_height();
+    bool new_image = update.image != image_;
+    if (new_image) {
+        // The texture is kept for an image of the same size, so that the
+        // new one is drawn over the old one as it arrives
+        if (width != image_->get_width() || height != image_->get_height() ||
+            !texture_.is_valid()) {
+            texture_ = Texture(width, height);
+            image_size_ = glm::dvec2(width, height);
+        }
+        image_ = update.image;
+        stream_rows_ = 0;
+        orientation_ = Orientation::from_exif(image_->get_exif_orientation());
+    }
+    if (update.rows > stream_rows_) {
+        texture_.update(*image_, 0, stream_rows_, width,
+                        update.rows - stream_rows_);
+        stream_rows_ = update.rows;
+    }
+    if (new_image && best_fit_) {
+        calc_best_fit();
+    }
+    stream_complete_ = update.complete;
+    if (stream_complete_) {
+        // The histogram shows the previous image until this one is complete
+        source_profile_ = get_source_profile(*image_);
+        color_transform_ = ColorTransform(source_profile_, display_profile_);
+        statistics_ = std::make_unique<ImageStatistics>(image_);
+        histogram_version_ = -1;
+    }
+    update_window_title();
+}
+
+// Draws the image, or the compared images. The output transform maps the
+// view to the part of it that is being drawn, for exports.
+void ImageViewer::draw_view(const glm::dmat4& transform_pos, double scale,
+                            const glm::dmat4& output_transform) {
+    if (compare_) {
+        const ShaderProgram& shader = compare_->use(image_size_);
+        set_filter_uniforms(shader, transform_pos, scale);
+        shader.set_uniform("output_transform", output_transform);
+        compare_->draw(square_);
+        return;
+    }
+    Texture& texture = get_resident_texture();
+    draw_texture(texture, output_transform * transform_pos,
+                 scale * image_size_.x / texture.get_width());
+    if (detail_) {
+        draw_detail(output_transform * transform_pos, scale);
+    }
+}
+
+void ImageViewer::draw_texture(Texture& texture,
+                               const glm::dmat4& transform_pos,
+                               double texel_scale) {
     shader_.use();
-    texture_.bind_to_unit(GL_TEXTURE0);
+    texture.bind_to_unit(GL_TEXTURE0);
     shader_.set_uniform("tex0", 0);
-    shader_.set_uniform("transform_pos", transform_pos);
-    shader_.set_uniform("image_size", image_size_);
-    shader_.set_uniform("pixel_size", pixel_size);
-    shader_.set_uniform("gaussian_a", gaussian_a);
-    shader_.set_uniform("srgb_enabled", srgb_enabled_ ? 1 : 0);
-    shader_.set_uniform("g_filter_type", static_cast<int>(filter_type));
+    shader_.set_uniform("image_size",
+                        glm::vec2(texture.get_width(), texture.get_height()));
+    set_filter_uniforms(shader_, transform_pos, texel_scale);
     square_.render(shader_);
 }
 
+void ImageViewer::update_detail(const glm::dmat4& transform_pos) {
+    // Full resolution is only needed where the preview would be enlarged
+    if (scale_ * image_size_.x / image_->get_width() <= 1.0) {
+        detail_->clear();
+        return;
+    }
+
+    // Visible pixels, from the window corners through the inverse transform
+    glm::dmat4 inverse = glm::inverse(transform_pos);
+    glm::dvec2 visible_min(image_size_);
+    glm::dvec2 visible_max(0.0);
+    for (glm::dvec2 corner : {glm::dvec2(-1.0, -1.0), glm::dvec2(1.0, -1.0),
+                              glm::dvec2(-1.0, 1.0), glm::dvec2(1.0, 1.0)}) {
+        glm::dvec4 pos = inverse * glm::dvec4(corner, 0.0, 1.0);
+        glm::dvec2 pixel =
+            glm::dvec2(pos.x + 1.0, 1.0 - pos.y) / 2.0 * image_size_;
+        visible_min = glm::min(visible_min, pixel);
+        visible_max = glm::max(visible_max, pixel);
+    }
+    detail_->request(glm::ivec2(glm::floor(visible_min)),
+                     glm::ivec2(glm::ceil(visible_max)));
+    detail_->update();
+}
+
+void ImageViewer::draw_detail(const glm::dmat4& transform_pos, double scale) {
+    if (!detail_->has_texture()) {
+        return; // The preview shows until the region is decoded
+    }
+
+    // The region's part of the image's square
+    glm::dvec2 region_min(detail_->get_min());
+    glm::dvec2 region_max(detail_->get_max());
+    glm::dvec2 center = (region_min + region_max) / image_size_ - 1.0;
+    glm::dvec2 half_size = (region_max - region_min) / image_size_;
+    glm::dmat4 region = glm::translate(glm::dmat4(1.0),
+                                       glm::dvec3(center.x, -center.y, 0.0));
+    region = glm::scale(region, glm::dvec3(half_size, 1.0));
+    draw_texture(detail_->get_texture(), transform_pos * region, scale);
+}
+
+void ImageViewer::start_export() {
+    if (export_) {
+        std::cout << "Already exporting the view\n";
+        return;
+    }
+    glm::ivec2 size = glm::max(
+        glm::ivec2(glm::round(window_size_ * export_scale_)), glm::ivec2(1));
+    try {
+        export_ = std::make_unique<ViewExport>(
+            get_export_filename(filename_, size), size);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to export the view: " << e.what() << "\n";
+        return;
+    }
+    // The output shows the same part of the image, so only the scale
+    // changes
+    export_transform_ = get_transform_pos();
+    export_texel_scale_ = scale_ * export_scale_;
+}
+
+void ImageViewer::continue_export() {
+    GLint framebuffer = 0;
+    GLint viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    drawn_pixels_ = 0.0;
+    for (int i = 0; i < EXPORT_TILES_PER_FRAME && export_->has_next_tile();
+         i++) {
+        glm::dmat4 output_transform = export_->begin_tile();
+        draw_view(export_transform_, export_texel_scale_, output_transform);
+        export_->end_tile();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (export_->update()) {
+        export_.reset();
+        update_window_title();
+    }
+}
+
+void ImageViewer::draw_histogram() {
+    int version = statistics_->get_version();
+    if (version != histogram_version_) {
+        histogram_view_->update(statistics_->get_result());
+        histogram_version_ = version;
+        if (statistics_->is_complete()) {
+            update_window_title(); // Show the clipping
+        }
+    }
+    histogram_view_->draw(square_, window_size_);
+}
+
+double ImageViewer::get_time_to_next_frame() const {
+    double timeout = -1.0;
+    if (animation_ && !compare_) {
+        timeout = animation_->get_time_to_next_frame();
+    }
+    if ((detail_ && detail_->is_decoding()) || reloading_.valid() ||
+        export_) {
+        timeout = timeout < 0.0 ? 0.01 : std::min(timeout, 0.01);
+    }
+    if (histogram_view_ && !statistics_->is_complete()) {
+        // Show partial histograms while the rest is counted
+        timeout = timeout < 0.0 ? 0.05 : std::min(timeout, 0.05);
+    }
+    return timeout;
+}
+
+void ImageViewer::set_filter_uniforms(const ShaderProgram& shader,
+                                      const glm::dmat4& transform_pos,
+                                      double texel_scale) {
+    float pixel_size = std::max(1.0 / texel_scale, 1.0);
+
+    // A filter that has been selected keeps the shader's defaults for the
+    // Gaussian (8 sigmas wide) and Lanczos (3 lobes)
+    FilterChoice filter;
+    filter.type = filter_type_;
+    filter.support = filter_type_ == FilterType::LANCZOS ? 3.0 : 8.0;
+    filter.gaussian_sigma = gaussian_sigma_;
+    int kernel = kernel_ >= 0 ? FILTER_KERNEL + kernel_ : 0;
+    if (std::fabs(texel_scale - 1.0) < 0.000001) {
+        filter.type = FilterType::BOX; // box when no scaling
+        kernel = 0;
+    } else if (filter_type_ == FilterType::AUTO && kernel == 0) {
+        filter = filter_selector_.choose(
+            texel_scale, statistics_->get_edge_density(), drawn_pixels_);
+    }
+    drawn_filter_ = filter;
+    drawn_texel_scale_ = texel_scale;
+    float gaussian_sigma = filter.type == FilterType::GAUSSIAN
+                               ? filter.gaussian_sigma
+                               : gaussian_sigma_;
+    float gaussian_a = 1.0 / (2.0 * gaussian_sigma * gaussian_sigma);
+
+    color_transform_.apply(shader, 1, 2);
+    kernels_.apply(shader, 3);
+    adjustments_.apply(shader);
+    shader.set_uniform("transform_pos", transform_pos);
+    shader.set_uniform("pixel_size", pixel_size);
+    shader.set_uniform("gaussian_a", gaussian_a);
+    shader.set_uniform(
+        "gaussian_support",
+        static_cast<float>(filter.type == FilterType::GAUSSIAN ? filter.support
+                                                               : 8.0));
+    shader.set_uniform(
+        "lanczos_a",
+        static_cast<float>(filter.type == FilterType::LANCZOS ? filter.support
+                                                              : 3.0));
+    shader.set_uniform("srgb_enabled", srgb_enabled_ ? 1 : 0);
+    shader.set_uniform("g_filter_type",
+                       kernel != 0 ? kernel : static_cast<int>(filter.type));
+}
+
 void ImageViewer::set_size(int width, int height) {
     window_size_ = glm::dvec2(width, height);
 
@@ -107,54 +656,187 @@ void ImageViewer::set_size(int width, int height) {
     }
 }
 
+void ImageViewer::set_filter_type(FilterType filter_type) {
+    filter_type_ = filter_type;
+    kernel_ = -1;
+    update_window_title();
+}
+
+void ImageViewer::set_display_profile(const ColorProfile& display_profile) {
+    display_profile_ = display_profile;
+    color_transform_ = ColorTransform(source_profile_, display_profile);
+}
+
+void ImageViewer::set_scale(double scale) {
+    best_fit_ = false;
+    translate_ = glm::dvec2(0.0);
+    scale_ = scale;
+    update_window_title();
+}
+
+void ImageViewer::set_compressed(bool compressed) {
+    compressed_ = compressed;
+    std::cout << "Compressed: " << compressed_ << "\n";
+    update_window_title();
+}
+
+void ImageViewer::set_export_scale(double export_scale) {
+    export_scale_ = export_scale;
+}
+
+void ImageViewer::set_filter_budget(double milliseconds) {
+    filter_selector_.set_budget(milliseconds);
+}
+
+void ImageViewer::add_compare_image(const std::string& filename) {
+    if (detail_ || stream_) {
+        std::cerr << "Can not compare with an image decoded by region or "
+                     "read from a stream\n";
+        return;
+    }
+    watcher_.reset(); // The compared images are not reloaded
+    if (!compare_) {
+        compare_ =
+            std::make_unique<CompareView>(kernels_.get_shader_sources());
+        compare_->add_image(image_);
+    }
+    compare_->add_image(std::make_shared<const Image>(filename));
+    if (best_fit_) {
+        calc_best_fit();
+    }
+    update_window_title();
+}
+
 void ImageViewer::key_event(int key, int action) {
     if (key == GLFW_KEY_S && action == GLFW_PRESS) {
         srgb_enabled_ = !srgb_enabled_;
         std::cout << "sRGB: " << srgb_enabled_ << "\n";
     } else if (key == GLFW_KEY_E && action == GLFW_PRESS) {
-        switch (filter_type_) {
-        case FilterType::AUTO:
-            filter_type_ = FilterType::LANCZOS;
-            break;
-        case FilterType::BOX:
-            filter_type_ = FilterType::AUTO;
-            break;
-        case FilterType::TENT:
-            filter_type_ = FilterType::BOX;
-            break;
-        case FilterType::GAUSSIAN:
-            filter_type_ = FilterType::TENT;
-            break;
-        case FilterType::LANCZOS:
-            filter_type_ = FilterType::GAUSSIAN;
-            break;
-        default:
-            std::cerr << "Unknown filter type\n";
-            break;
+        if (kernel_ >= 0) {
+            // The declared kernels come after the built-in filters
+            kernel_--;
+            if (kernel_ < 0) {
+                filter_type_ = FilterType::LANCZOS;
+            }
+        } else if (filter_type_ == FilterType::AUTO &&
+                   kernels_.get_count() > 0) {
+            kernel_ = kernels_.get_count() - 1;
+        } else {
+            switch (filter_type_) {
+            case FilterType::AUTO:
+                filter_type_ = FilterType::LANCZOS;
+                break;
+            case FilterType::BOX:
+                filter_type_ = FilterType::AUTO;
+                break;
+            case FilterType::TENT:
+                filter_type_ = FilterType::BOX;
+                break;
+            case FilterType::GAUSSIAN:
+                filter_type_ = FilterType::TENT;
+                break;
+            case FilterType::LANCZOS:
+                filter_type_ = FilterType::GAUSSIAN;
+                break;
+            default:
+                std::cerr << "Unknown filter type\n";
+                break;
+            }
         }
         std::cout << "Filter type: " << get_filter_name() << "\n";
     } else if (key == GLFW_KEY_R && action == GLFW_PRESS) {
-        switch (filter_type_) {
-        case FilterType::AUTO:
-            filter_type_ = FilterType::BOX;
-            break;
-        case FilterType::BOX:
-            filter_type_ = FilterType::TENT;
-            break;
-        case FilterType::TENT:
-            filter_type_ = FilterType::GAUSSIAN;
-            break;
-        case FilterType::GAUSSIAN:
-            filter_type_ = FilterType::LANCZOS;
-            break;
-        case FilterType::LANCZOS:
-            filter_type_ = FilterType::AUTO;
-            break;
-        default:
-            std::cerr << "Unknown filter type\n";
-            break;
+        if (kernel_ >= 0) {
+            kernel_++;
+            if (kernel_ >= kernels_.get_count()) {
+                kernel_ = -1;
+                filter_type_ = FilterType::AUTO;
+            }
+        } else if (filter_type_ == FilterType::LANCZOS &&
+                   kernels_.get_count() > 0) {
+            kernel_ = 0;
+        } else {
+            switch (filter_type_) {
+            case FilterType::AUTO:
+                filter_type_ = FilterType::BOX;
+                break;
+            case FilterType::BOX:
+                filter_type_ = FilterType::TENT;
+                break;
+            case FilterType::TENT:
+                filter_type_ = FilterType::GAUSSIAN;
+                break;
+            case FilterType::GAUSSIAN:
+                filter_type_ = FilterType::LANCZOS;
+                break;
+            case FilterType::LANCZOS:
+                filter_type_ = FilterType::AUTO;
+                break;
+            default:
+                std::cerr << "Unknown filter type\n";
+                break;
+            }
         }
         std::cout << "Filter type: " << get_filter_name() << "\n";
+    } else if (key == GLFW_KEY_L && action == GLFW_PRESS && compare_) {
+        compare_->next_layout();
+        if (best_fit_) {
+            calc_best_fit();
+        }
+    } else if (key == GLFW_KEY_TAB && action == GLFW_PRESS && compare_) {
+        compare_->next_image();
+    } else if (key == GLFW_KEY_D && action == GLFW_PRESS && compare_) {
+        compare_->toggle_difference();
+    } else if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        if (histogram_view_) {
+            histogram_view_.reset();
+        } else {
+            histogram_view_ = std::make_unique<HistogramView>();
+            histogram_version_ = -1;
+        }
+    } else if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        inspector_ = !inspector_;
+    } else if (key == GLFW_KEY_EQUAL && action != GLFW_RELEASE) {
+        adjustments_.change_exposure(1.0 / 3.0);
+    } else if (key == GLFW_KEY_MINUS && action != GLFW_RELEASE) {
+        adjustments_.change_exposure(-1.0 / 3.0);
+    } else if (key == GLFW_KEY_LEFT_BRACKET && action != GLFW_RELEASE) {
+        adjustments_.change_black_point(-0.01);
+    } else if (key == GLFW_KEY_RIGHT_BRACKET && action != GLFW_RELEASE) {
+        adjustments_.change_black_point(0.01);
+    } else if (key == GLFW_KEY_SEMICOLON && action != GLFW_RELEASE) {
+        adjustments_.change_white_point(-0.05);
+    } else if (key == GLFW_KEY_APOSTROPHE && action != GLFW_RELEASE) {
+        adjustments_.change_white_point(0.05);
+    } else if (key == GLFW_KEY_COMMA && action != GLFW_RELEASE) {
+        adjustments_.change_gamma(-0.1);
+    } else if (key == GLFW_KEY_PERIOD && action != GLFW_RELEASE) {
+        adjustments_.change_gamma(0.1);
+    } else if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        adjustments_.toggle_tone_mapping();
+    } else if (key == GLFW_KEY_0 && action == GLFW_PRESS) {
+        adjustments_.reset();
+        std::cout << "Adjustments reset\n";
+    } else if ((key == GLFW_KEY_T || key == GLFW_KEY_Y || key == GLFW_KEY_X ||
+                key == GLFW_KEY_V) &&
+               action == GLFW_PRESS) {
+        if (key == GLFW_KEY_T) {
+            orientation_.rotate_clockwise();
+        } else if (key == GLFW_KEY_Y) {
+            orientation_.rotate_counterclockwise();
+        } else if (key == GLFW_KEY_X) {
+            orientation_.flip_horizontal();
+        } else {
+            orientation_.flip_vertical();
+        }
+        if (best_fit_) {
+            calc_best_fit();
+        }
+    } else if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        set_compressed(!compressed_);
+    } else if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        start_export();
+    } else if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+        GpuMemory::shared().report("Resident textures", true);
     } else if (key == GLFW_KEY_F && action == GLFW_PRESS) {
         best_fit_ = true;
         std::cout << "Best fit: true\n";
@@ -177,9 +859,12 @@ void ImageViewer::scroll_event(double offset, glm::dvec2 pos) {
     if (std::fabs(scale_ - 1.0) < 0.01) {
         scale_ = 1.0; // Snap to 100% when close
     }
-    glm::dvec2 center = window_size_ / 2.0;
+    // Zoom relative to the view (compare cell) under the cursor
+    glm::dvec2 view_size = get_view_size();
+    glm::dvec2 view_pos = glm::mod(pos, view_size);
+    glm::dvec2 center = view_size / 2.0;
     // Update translation (to keep the zooming centered on pos)
-    glm::dvec2 inverted_pos = glm::dvec2(pos.x, window_size_.y - pos.y);
+    glm::dvec2 inverted_pos = glm::dvec2(view_pos.x, view_size.y - view_pos.y);
     translate_ = ((translate_ * old_scale + center - inverted_pos) * change +
                   inverted_pos - center) /
                  scale_;
@@ -200,6 +885,10 @@ void ImageViewer::mouse_button_event(int button, int action, glm::dvec2 pos) {
 }
 
 void ImageViewer::mouse_move_event(glm::dvec2 pos) {
+    mouse_pos_ = pos;
+    if (inspector_) {
+        update_window_title();
+    }
     if (mouse_down_) {
         glm::dvec2 delta = pos - mouse_last_pos_;
         mouse_last_pos_ = pos;
@@ -211,9 +900,88 @@ void ImageViewer::mouse_move_event(glm::dvec2 pos) {
     }
 }
 
+Texture& ImageViewer::get_resident_texture() {
+    if (animation_ && animation_->has_frame()) {
+        // Frames are always uploaded uncompressed
+        texture_ = Texture();
+        compressed_texture_ = Texture();
+        return animation_->get_texture();
+    }
+    if (stream_) {
+        return texture_; // Uploaded as the rows arrive, never compressed
+    }
+    if (!compressed_) {
+        compressed_texture_ = Texture();
+    } else if (!compressed_texture_.is_valid()) {
+        try {
+            compressed_texture_ = Texture(
+                filename_.empty() || detail_
+                    ? CompressedImage(*image_)
+                    : CompressedImage::load_or_encode(*image_, filename_));
+            compressed_texture_.set_evictable();
+        } catch (const GlOutOfMemory& e) {
+            std::cerr << "No compressed texture: " << e.what() << "\n";
+            compressed_ = false;
+        }
+    }
+    // Exact texels are only needed when individual pixels can be seen
+    if (compressed_ && scale_ < 1.0 - 0.000001) {
+        texture_ = Texture();
+        return compressed_texture_;
+    }
+    if (!texture_.is_valid()) {
+        texture_ = upload_image();
+    }
+    return texture_;
+}
+
+Texture ImageViewer::upload_image() {
+    std::shared_ptr<const Image> image = image_;
+    for (int reduction = 1;; reduction *= 2) {
+        try {
+            Texture texture(*image);
+            if (!stream_) {
+                texture.set_evictable(); // Uploaded again when needed
+            }
+            if (reduction > 1) {
+                std::cout << "Showing the image at 1/" << reduction
+                          << " resolution\n";
+                GpuMemory::shared().count_reduced();
+            }
+            return texture;
+        } catch (const GlOutOfMemory& e) {
+            if (std::max(image->get_width(), image->get_height()) <=
+                MIN_REDUCED_SIZE) {
+                throw;
+            }
+            std::cerr << "No room for the image at 1/" << reduction
+                      << " resolution: " << e.what() << "\n";
+            image = std::make_shared<const Image>(halve(*image));
+        }
+    }
+}
+
+glm::dmat4 ImageViewer::get_transform_pos() {
+    glm::dmat4 transform_pos(1.0);
+    transform_pos = glm::scale(transform_pos,
+                               glm::dvec3(2.0 * scale_ / get_view_size(), 1.0));
+    transform_pos = glm::translate(transform_pos, glm::dvec3(translate_, 0.0));
+    transform_pos = transform_pos * orientation_.get_transform();
+    return glm::scale(transform_pos, glm::dvec3(image_size_ / 2.0, 1.0));
+}
+
+glm::dvec2 ImageViewer::get_view_size() {
+    if (compare_) {
+        return window_size_ / glm::dvec2(compare_->get_grid());
+    }
+    return window_size_;
+}
+
 void ImageViewer::calc_best_fit() {
-    double scale0 = window_size_.x / image_size_.x;
-    double scale1 = window_size_.y / image_size_.y;
+    glm::dvec2 view_size = get_view_size();
+    glm::dvec2 image_size = orientation_.apply_to_size(image_size_);
+    double scale0 = view_size.x / image_size.x;
+    double scale1 = view_size.y / image_size.y;
     scale_ = std::min(scale0, scale1);
     translate_ = glm::dvec2(0.0);
     update_window_title();
@@ -226,11 +994,78 @@ void ImageViewer::update_window_title() {
     if (!srgb_enabled_) {
         title += "; sRGB off";
     }
+    if (compressed_ && !stream_ && scale_ < 1.0 - 0.000001) {
+        title += "; ETC2";
+    }
+    if (compare_) {
+        title += "; " + compare_->get_description();
+    }
+    if (!orientation_.is_identity()) {
+        title += "; " + orientation_.get_description();
+    }
+    if (!adjustments_.is_identity()) {
+        title += "; " + adjustments_.get_description();
+    }
+    if (histogram_view_ && statistics_->is_complete()) {
+        double pixels = static_cast<double>(statistics_->get_total_pixels());
+        ImageStatistics::Result result = statistics_->get_result();
+        char clipped[64];
+        std::snprintf(clipped, sizeof(clipped), "; clipped %.2f%% / %.2f%%",
+                      100.0 * result.clipped_shadows / pixels,
+                      100.0 * result.clipped_highlights / pixels);
+        title += clipped;
+    }
+    if (export_) {
+        title += "; exporting";
+    }
+    if (stream_ && !stream_complete_) {
+        title += "; receiving";
+    }
     title += ")";
+    if (inspector_) {
+        title += " " + get_pixel_description();
+    }
     glfwSetWindowTitle(window_, title.c_str());
 }
 
+std::string ImageViewer::get_pixel_description() {
+    if (compare_) {
+        return "";
+    }
+    // Window position to image pixel, through the transform that is used
+    // for drawing, so no read back from the GPU is needed
+    glm::dvec4 clip_pos(2.0 * mouse_pos_.x / window_size_.x - 1.0,
+                        1.0 - 2.0 * mouse_pos_.y / window_size_.y, 0.0, 1.0);
+    glm::dvec4 square_pos = glm::inverse(get_transform_pos()) * clip_pos;
+    glm::dvec2 texcoord =
+        glm::dvec2(square_pos.x + 1.0, 1.0 - square_pos.y) / 2.0;
+    glm::ivec2 pixel = glm::floor(texcoord * image_size_);
+    if (pixel.x < 0 || pixel.y < 0 || pixel.x >= image_size_.x ||
+        pixel.y >= image_size_.y) {
+        return "[outside]";
+    }
+    if (stream_ && pixel.y >= stream_rows_) {
+        return "[not received]";
+    }
+    unsigned char rgb[3];
+    if (detail_) {
+        detail_->get_image().get_pixel(pixel.x, pixel.y, rgb);
+    } else {
+        std::memcpy(rgb,
+                    image_->get_data() +
+                        (static_cast<size_t>(pixel.y) * image_->get_width() +
+                         pixel.x) * 3,
+                    3);
+    }
+    return "[" + std::to_string(pixel.x) + ", " + std::to_string(pixel.y) +
+           ": " + std::to_string(rgb[0]) + " " + std::to_string(rgb[1]) +
+           " " + std::to_string(rgb[2]) + "]";
+}
+
 std::string ImageViewer::get_filter_name() {
+    if (kernel_ >= 0) {
+        return kernels_.get_name(kernel_);
+    }
     switch (filter_type_) {
     case FilterType::AUTO:
         return "Auto";
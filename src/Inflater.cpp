@@ -0,0 +1,370 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <imageviewer/Inflater.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace imageviewer {
+
+namespace {
+
+// How far back the compressed data can refer
+const size_t WINDOW_SIZE = 32768;
+// Used input and output is dropped in pieces of at least this size
+const size_t TRIM_SIZE = 1 << 20;
+
+const int LENGTH_BASE[]{3,  4,  5,  6,  7,  8,  9,  10, 11,  13,
+                        15, 17, 19, 23, 27, 31, 35, 43, 51,  59,
+                        67, 83, 99, 115, 131, 163, 195, 227, 258};
+const int LENGTH_EXTRA[]{0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                         2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const int DIST_BASE[]{1,    2,    3,    4,    5,    7,     9,     13,
+                      17,   25,   33,   49,   65,   97,    129,   193,
+                      257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                      4097, 6145, 8193, 12289, 16385, 24577};
+const int DIST_EXTRA[]{0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                       6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// Order of the code length code lengths in a dynamic block header
+const int LENGTH_ORDER[]{16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                         11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+std::runtime_error invalid_data() {
+    return std::runtime_error("Invalid compressed data");
+}
+
+} // namespace
+
+Inflater::Inflater()
+    : position_{0}, taken_{0}, state_{State::HEADER}, final_block_{false},
+      stored_remaining_{0} {}
+
+void Inflater::add_input(const unsigned char* data, size_t size) {
+    size_t used = position_ / 8;
+    if (used >= TRIM_SIZE) {
+        input_.erase(input_.begin(), input_.begin() + used);
+        position_ -= used * 8;
+    }
+    input_.insert(input_.end(), data, data + size);
+}
+
+void Inflater::inflate() {
+    while (state_ != State::DONE) {
+        size_t checkpoint = position_;
+        if (!step()) {
+            position_ = checkpoint;
+            return;
+        }
+    }
+}
+
+void Inflater::take_output(size_t size) {
+    taken_ += size;
+    if (taken_ >= TRIM_SIZE) {
+        size_t trim = taken_ - WINDOW_SIZE;
+        output_.erase(output_.begin(), output_.begin() + trim);
+        taken_ -= trim;
+    }
+}
+
+bool Inflater::step() {
+    switch (state_) {
+    case State::HEADER: {
+        uint32_t header;
+        if (!read_bits(16, header)) {
+            return false;
+        }
+        uint32_t method = header & 0xff;
+        uint32_t flags = header >> 8;
+        // Deflate, with a valid check value and no preset dictionary
+        if ((method & 15) != 8 || (method << 8 | flags) % 31 != 0 ||
+            (flags & 0x20) != 0) {
+            throw std::runtime_error("Invalid zlib header");
+        }
+        state_ = State::BLOCK;
+        return true;
+    }
+    case State::BLOCK:
+        return read_block_header();
+    case State::STORED: {
+        size_t start = position_ / 8;
+        size_t size = std::min(stored_remaining_, input_.size() - start);
+        if (size == 0) {
+            return false;
+        }
+        output_.insert(output_.end(), input_.begin() + start,
+                       input_.begin() + start + size);
+        position_ += size * 8;
+        stored_remaining_ -= size;
+        if (stored_remaining_ == 0) {
+            state_ = final_block_ ? State::DONE : State::BLOCK;
+        }
+        return true;
+    }
+    case State::HUFFMAN:
+        return decode_symbol();
+    case State::DONE:
+        return false;
+    }
+    return false;
+}
+
+bool Inflater::read_block_header() {
+    uint32_t header;
+    if (!read_bits(3, header)) {
+        return false;
+    }
+    final_block_ = (header & 1) != 0;
+    uint32_t type = header >> 1;
+    if (type == 0) {
+        // Stored, from the next byte boundary
+        position_ = (position_ + 7) & ~size_t{7};
+        uint32_t length, complement;
+        if (!read_bits(16, length) || !read_bits(16, complement)) {
+            return false;
+        }
+        if ((length ^ 0xffff) != complement) {
+            throw invalid_data();
+        }
+        stored_remaining_ = length;
+        state_ = length > 0 ? State::STORED
+                            : final_block_ ? State::DONE : State::BLOCK;
+    } else if (type == 1) {
+        static const Huffman fixed_literals = [] {
+            uint8_t lengths[288];
+            std::fill(lengths, lengths + 144, 8);
+            std::fill(lengths + 144, lengths + 256, 9);
+            std::fill(lengths + 256, lengths + 280, 7);
+            std::fill(lengths + 280, lengths + 288, 8);
+            Huffman code;
+            build_code(code, lengths, 288);
+            return code;
+        }();
+        static const Huffman fixed_distances = [] {
+            uint8_t lengths[30];
+            std::fill(lengths, lengths + 30, 5);
+            Huffman code;
+            build_code(code, lengths, 30);
+            return code;
+        }();
+        literals_ = fixed_literals;
+        distances_ = fixed_distances;
+        state_ = State::HUFFMAN;
+    } else if (type == 2) {
+        if (!read_dynamic_tables()) {
+            return false;
+        }
+        state_ = State::HUFFMAN;
+    } else {
+        throw invalid_data();
+    }
+    return true;
+}
+
+bool Inflater::read_dynamic_tables() {
+    uint32_t literal_count, distance_count, length_count;
+    if (!read_bits(5, literal_count) || !read_bits(5, distance_count) ||
+        !read_bits(4, length_count)) {
+        return false;
+    }
+    literal_count += 257;
+    distance_count += 1;
+    length_count += 4;
+    if (literal_count > 286 || distance_count > 30) {
+        throw invalid_data();
+    }
+
+    // The code lengths are Huffman coded themselves
+    uint8_t length_lengths[19] = {0};
+    for (uint32_t i = 0; i < length_count; i++) {
+        uint32_t length;
+        if (!read_bits(3, length)) {
+            return false;
+        }
+        length_lengths[LENGTH_ORDER[i]] = static_cast<uint8_t>(length);
+    }
+    Huffman length_code;
+    build_code(length_code, length_lengths, 19);
+
+    uint8_t lengths[286 + 30];
+    uint32_t total = literal_count + distance_count;
+    for (uint32_t count = 0; count < total;) {
+        int symbol;
+        if (!read_symbol(length_code, symbol)) {
+            return false;
+        }
+        if (symbol < 16) {
+            lengths[count++] = static_cast<uint8_t>(symbol);
+            continue;
+        }
+        // Repeated lengths
+        uint32_t repeat;
+        uint8_t length = 0;
+        if (symbol == 16) {
+            if (count == 0) {
+                throw invalid_data(); // Nothing to repeat
+            }
+            if (!read_bits(2, repeat)) {
+                return false;
+            }
+            length = lengths[count - 1];
+            repeat += 3;
+        } else if (symbol == 17) {
+            if (!read_bits(3, repeat)) {
+                return false;
+            }
+            repeat += 3;
+        } else {
+            if (!read_bits(7, repeat)) {
+                return false;
+            }
+            repeat += 11;
+        }
+        if (count + repeat > total) {
+            throw invalid_data();
+        }
+        std::fill(lengths + count, lengths + count + repeat, length);
+        count += repeat;
+    }
+    if (lengths[256] == 0) {
+        throw invalid_data(); // No end of block
+    }
+    build_code(literals_, lengths, literal_count);
+    build_code(distances_, lengths + literal_count, distance_count);
+    return true;
+}
+
+bool Inflater::decode_symbol() {
+    int symbol;
+    if (!read_symbol(literals_, symbol)) {
+        return false;
+    }
+    if (symbol < 256) {
+        output_.push_back(static_cast<unsigned char>(symbol));
+        return true;
+    } else if (symbol == 256) {
+        state_ = final_block_ ? State::DONE : State::BLOCK;
+        return true;
+    }
+
+    // A copy of earlier output
+    symbol -= 257;
+    if (symbol >= 29) {
+        throw invalid_data();
+    }
+    uint32_t extra;
+    if (!read_bits(LENGTH_EXTRA[symbol], extra)) {
+        return false;
+    }
+    size_t length = LENGTH_BASE[symbol] + extra;
+    if (!read_symbol(distances_, symbol)) {
+        return false;
+    }
+    if (symbol >= 30) {
+        throw invalid_data();
+    }
+    if (!read_bits(DIST_EXTRA[symbol], extra)) {
+        return false;
+    }
+    size_t distance = DIST_BASE[symbol] + extra;
+    if (distance > output_.size()) {
+        throw invalid_data();
+    }
+    // Byte by byte, since the copy can overlap what it adds
+    size_t from = output_.size() - distance;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char value = output_[from + i];
+        output_.push_back(value);
+    }
+    return true;
+}
+
+bool Inflater::read_symbol(const Huffman& code, int& symbol) {
+    uint16_t entry = code.table[peek_bits(code.bits)];
+    size_t length = entry & 15;
+    size_t available = get_available_bits();
+    if (length == 0 || length > available) {
+        // Past the end, the missing bits read as zeros
+        if (available < static_cast<size_t>(code.bits)) {
+            return false;
+        }
+        throw invalid_data();
+    }
+    position_ += length;
+    symbol = entry >> 4;
+    return true;
+}
+
+bool Inflater::read_bits(int count, uint32_t& value) {
+    if (static_cast<size_t>(count) > get_available_bits()) {
+        return false;
+    }
+    value = peek_bits(count);
+    position_ += count;
+    return true;
+}
+
+uint32_t Inflater::peek_bits(int count) const {
+    // Least significant bit first, at most 25 bits
+    size_t byte = position_ / 8;
+    uint32_t bits = 0;
+    for (size_t i = 0; i < 4 && byte + i < input_.size(); i++) {
+        bits |= static_cast<uint32_t>(input_[byte + i]) << (8 * i);
+    }
+    return (bits >> (position_ % 8)) & ((1u << count) - 1);
+}
+
+void Inflater::build_code(Huffman& code, const uint8_t* lengths,
+                          int count) {
+    int counts[16] = {0};
+    int max_length = 1;
+    for (int i = 0; i < count; i++) {
+        counts[lengths[i]]++;
+        max_length = std::max(max_length, static_cast<int>(lengths[i]));
+    }
+    // The first code of each length, as in RFC 1951
+    int next[16] = {0};
+    int first = 0;
+    counts[0] = 0;
+    for (int length = 1; length < 16; length++) {
+        first = (first + counts[length - 1]) << 1;
+        next[length] = first;
+        if (first + counts[length] > 1 << length) {
+            throw invalid_data(); // Over-subscribed
+        }
+    }
+
+    // Each code fills the entries that start with its bits (reversed, as
+    // they are read)
+    code.bits = max_length;
+    code.table.assign(size_t{1} << max_length, 0);
+    for (int symbol = 0; symbol < count; symbol++) {
+        int length = lengths[symbol];
+        if (length == 0) {
+            continue;
+        }
+        int value = next[length]++;
+        int reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed = reversed << 1 | ((value >> i) & 1);
+        }
+        for (size_t i = reversed; i < code.table.size(); i += 1 << length) {
+            code.table[i] = static_cast<uint16_t>(symbol << 4 | length);
+        }
+    }
+}
+
+} // namespace imageviewer
@@ -0,0 +1,317 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/MetadataIndex.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <imageviewer/Cache.h>
+#include <imageviewer/Orientation.h>
+#include <imageviewer/ThreadPool.h>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <stb_image.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace imageviewer {
+
+namespace {
+
+const char INDEX_MAGIC[8] = {'I', 'V', 'I', 'N', 'D', 'E', 'X', '1'};
+
+// Files per pool task when probing
+const size_t PROBE_BATCH = 64;
+
+// Index file name derived from the absolute path of the directory
+std::string get_index_file(const std::string& directory) {
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::absolute(directory, error);
+    if (error) {
+        return "";
+    }
+    return get_cache_file_name(path.string(), "index");
+}
+
+int64_t get_modified(const struct stat& file_stat) {
+    return static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 +
+           file_stat.st_mtim.tv_nsec;
+}
+
+bool has_extension(const std::string& path, const std::string& extension) {
+    if (path.size() < extension.size()) {
+        return false;
+    }
+    auto same = [](char a, char b) {
+        return a == std::tolower(static_cast<unsigned char>(b));
+    };
+    return std::equal(extension.begin(), extension.end(),
+                      path.end() - extension.size(), same);
+}
+
+// Recognizes the formats that stb_image decodes by their signatures. TGA
+// has none, so it goes by the file extension.
+ImageFormat sniff_format(const std::string& path, const unsigned char* data,
+                         size_t size) {
+    auto starts_with = [&](const char* signature) {
+        size_t length = std::strlen(signature);
+        return size >= length && std::memcmp(data, signature, length) == 0;
+    };
+    if (starts_with("\xFF\xD8\xFF")) {
+        return ImageFormat::JPEG;
+    } else if (starts_with("\x89PNG\r\n\x1A\n")) {
+        return ImageFormat::PNG;
+    } else if (starts_with("GIF8")) {
+        return ImageFormat::GIF;
+    } else if (starts_with("BM")) {
+        return ImageFormat::BMP;
+    } else if (starts_with("8BPS")) {
+        return ImageFormat::PSD;
+    } else if (starts_with("#?RADIANCE") || starts_with("#?RGBE")) {
+        return ImageFormat::HDR;
+    } else if (starts_with("\x53\x80\xF6\x34")) {
+        return ImageFormat::PIC;
+    } else if (size >= 2 && data[0] == 'P' &&
+               (data[1] == '5' || data[1] == '6')) {
+        return ImageFormat::PNM;
+    } else if (has_extension(path, ".tga")) {
+        return ImageFormat::TGA;
+    }
+    return ImageFormat::UNKNOWN;
+}
+
+template <typename T> void write_value(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T> bool read_value(std::ifstream& in, T& value) {
+    return static_cast<bool>(
+        in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+} // namespace
+
+const char* get_format_name(ImageFormat format) {
+    switch (format) {
+    case ImageFormat::JPEG:
+        return "JPEG";
+    case ImageFormat::PNG:
+        return "PNG";
+    case ImageFormat::GIF:
+        return "GIF";
+    case ImageFormat::BMP:
+        return "BMP";
+    case ImageFormat::PSD:
+        return "PSD";
+    case ImageFormat::TGA:
+        return "TGA";
+    case ImageFormat::HDR:
+        return "HDR";
+    case ImageFormat::PIC:
+        return "PIC";
+    case ImageFormat::PNM:
+        return "PNM";
+    default:
+        return "Unknown";
+    }
+}
+
+ImageInfo probe_image(const std::string& path) {
+    ImageInfo info;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return info;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        return info;
+    }
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    info.file_size = size;
+    info.modified = get_modified(file_stat);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid
+    if (mapping == MAP_FAILED) {
+        return info;
+    }
+
+    auto data = static_cast<const unsigned char*>(mapping);
+    int length = static_cast<int>(std::min<size_t>(size, INT_MAX));
+    ImageFormat format = sniff_format(path, data, size);
+    if (format != ImageFormat::UNKNOWN &&
+        stbi_info_from_memory(data, length, &info.width, &info.height,
+                              &info.channels)) {
+        info.format = format;
+        info.bits_per_channel =
+            info.format == ImageFormat::HDR
+                ? 32
+                : stbi_is_16_bit_from_memory(data, length) ? 16 : 8;
+        if (info.format == ImageFormat::JPEG ||
+            info.format == ImageFormat::PNG) {
+            info.orientation = extract_exif_orientation(data, size);
+        }
+    }
+    munmap(mapping, size);
+    return info;
+}
+
+MetadataIndex::MetadataIndex(const std::string& directory)
+    : directory_{directory} {
+    auto start = std::chrono::steady_clock::now();
+    const std::string index_file = get_index_file(directory);
+    std::map<std::string, ImageInfo> indexed;
+    if (!index_file.empty() && load(index_file)) {
+        for (ImageInfo& info : files_) {
+            indexed.emplace(info.filename, std::move(info));
+        }
+    }
+
+    std::vector<std::string> names;
+    std::error_code error;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(directory, error)) {
+        if (entry.is_regular_file(error)) {
+            names.push_back(entry.path().filename().string());
+        }
+    }
+    if (error) {
+        throw std::runtime_error("Failed to list " + directory);
+    }
+    std::sort(names.begin(), names.end());
+
+    // Files that are unchanged since they were indexed only need a stat
+    files_.assign(names.size(), ImageInfo());
+    std::atomic<size_t> probed{0};
+    ThreadPool::shared().parallel_for(
+        (names.size() + PROBE_BATCH - 1) / PROBE_BATCH, [&](size_t batch) {
+            size_t end = std::min(names.size(), (batch + 1) * PROBE_BATCH);
+            for (size_t i = batch * PROBE_BATCH; i < end; i++) {
+                std::string path = directory + "/" + names[i];
+                auto it = indexed.find(names[i]);
+                struct stat file_stat;
+                if (it != indexed.end() &&
+                    stat(path.c_str(), &file_stat) == 0 &&
+                    static_cast<uint64_t>(file_stat.st_size) ==
+                        it->second.file_size &&
+                    get_modified(file_stat) == it->second.modified) {
+                    files_[i] = it->second;
+                } else {
+                    files_[i] = probe_image(path);
+                    files_[i].filename = names[i];
+                    probed++;
+                }
+            }
+        });
+
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "Indexed " << files_.size() << " files in " << directory
+              << " (" << probed << " probed) in " << seconds.count() * 1000.0
+              << " ms (" << files_.size() / seconds.count()
+              << " files/s)\n";
+    if (!index_file.empty() &&
+        (probed > 0 || indexed.size() != names.size())) {
+        save(index_file);
+    }
+}
+
+std::vector<ImageInfo> MetadataIndex::get_images() const {
+    std::vector<ImageInfo> images;
+    for (const ImageInfo& info : files_) {
+        if (info.is_image()) {
+            images.push_back(info);
+        }
+    }
+    return images;
+}
+
+bool MetadataIndex::load(const std::string& index_file) {
+    std::ifstream in(index_file, std::ios::in | std::ios::binary);
+    char magic[sizeof(INDEX_MAGIC)];
+    uint32_t count;
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 ||
+        !read_value(in, count)) {
+        return false;
+    }
+    // A corrupt count must not allocate more entries than the file can hold
+    const std::streamoff start = in.tellg();
+    in.seekg(0, std::ios::end);
+    const std::streamoff remaining = in.tellg() - start;
+    in.seekg(start);
+    const std::streamoff min_entry_size =
+        sizeof(uint32_t) + sizeof(uint64_t) + sizeof(int64_t) +
+        sizeof(int32_t) + 5 * sizeof(int);
+    if (!in || count > remaining / min_entry_size) {
+        return false;
+    }
+    files_.resize(count);
+    for (ImageInfo& info : files_) {
+        uint32_t name_length;
+        int32_t format;
+        if (!read_value(in, name_length) || name_length > 4096) {
+            files_.clear();
+            return false;
+        }
+        info.filename.resize(name_length);
+        if (!in.read(&info.filename[0], name_length) ||
+            !read_value(in, info.file_size) || !read_value(in, info.modified) ||
+            !read_value(in, format) || !read_value(in, info.width) ||
+            !read_value(in, info.height) || !read_value(in, info.channels) ||
+            !read_value(in, info.bits_per_channel) ||
+            !read_value(in, info.orientation)) {
+            files_.clear();
+            return false;
+        }
+        info.format = static_cast<ImageFormat>(format);
+    }
+    return true;
+}
+
+void MetadataIndex::save(const std::string& index_file) const {
+    bool written = write_cache_file(index_file, [&](std::ostream& out) {
+        out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        write_value(out, static_cast<uint32_t>(files_.size()));
+        for (const ImageInfo& info : files_) {
+            write_value(out, static_cast<uint32_t>(info.filename.size()));
+            out.write(info.filename.data(), info.filename.size());
+            write_value(out, info.file_size);
+            write_value(out, info.modified);
+            write_value(out, static_cast<int32_t>(info.format));
+            write_value(out, info.width);
+            write_value(out, info.height);
+            write_value(out, info.channels);
+            write_value(out, info.bits_per_channel);
+            write_value(out, info.orientation);
+        }
+    });
+    if (!written) {
+        std::cerr << "Failed to write index: " << index_file << "\n";
+    }
+}
+
+} // namespace imageviewer
@@ -0,0 +1,198 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/Orientation.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace imageviewer {
+
+namespace {
+
+const uint16_t ORIENTATION_TAG = 0x0112;
+
+uint32_t read_u32_be(const unsigned char* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) |
+           (data[2] << 8) | data[3];
+}
+
+// TIFF data (as in EXIF) is stored in either byte order
+struct TiffReader {
+    const unsigned char* data;
+    size_t size;
+    bool big_endian;
+
+    uint16_t u16(size_t pos) const {
+        return big_endian ? (data[pos] << 8) | data[pos + 1]
+                          : (data[pos + 1] << 8) | data[pos];
+    }
+
+    uint32_t u32(size_t pos) const {
+        return big_endian ? read_u32_be(data + pos)
+                          : (static_cast<uint32_t>(u16(pos + 2)) << 16) |
+                                u16(pos);
+    }
+};
+
+int read_tiff_orientation(const unsigned char* data, size_t size) {
+    if (size < 8 || (std::memcmp(data, "II", 2) != 0 &&
+                     std::memcmp(data, "MM", 2) != 0)) {
+        return 1;
+    }
+    TiffReader tiff{data, size, data[0] == 'M'};
+    if (tiff.u16(2) != 42) {
+        return 1;
+    }
+    // Only the first IFD (the main image) is searched
+    size_t ifd = tiff.u32(4);
+    if (ifd + 2 > size) {
+        return 1;
+    }
+    int entries = tiff.u16(ifd);
+    for (int i = 0; i < entries; i++) {
+        size_t entry = ifd + 2 + i * 12;
+        if (entry + 12 > size) {
+            break;
+        }
+        if (tiff.u16(entry) == ORIENTATION_TAG) {
+            int value = tiff.u16(entry + 8); // A SHORT stored in place
+            return value >= 1 && value <= 8 ? value : 1;
+        }
+    }
+    return 1;
+}
+
+int extract_png_orientation(const unsigned char* data, size_t size) {
+    size_t pos = 8;
+    while (pos + 12 <= size) {
+        uint32_t length = read_u32_be(data + pos);
+        const unsigned char* type = data + pos + 4;
+        if (length > size - pos - 12 || std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        if (std::memcmp(type, "eXIf", 4) == 0) {
+            return read_tiff_orientation(data + pos + 8, length);
+        }
+        pos += length + 12;
+    }
+    return 1;
+}
+
+int extract_jpeg_orientation(const unsigned char* data, size_t size) {
+    const char marker_name[] = "Exif\0"; // And the terminating null
+    size_t pos = 2;
+    while (pos + 4 <= size && data[pos] == 0xff) {
+        int marker = data[pos + 1];
+        if (marker == 0xd9 || marker == 0xda) {
+            break; // End of image or start of scan
+        }
+        size_t length = (data[pos + 2] << 8) | data[pos + 3];
+        if (length < 2 || pos + 2 + length > size) {
+            break;
+        }
+        const unsigned char* segment = data + pos + 4;
+        size_t segment_size = length - 2;
+        if (marker == 0xe1 && segment_size > sizeof(marker_name) &&
+            std::memcmp(segment, marker_name, sizeof(marker_name)) == 0) {
+            return read_tiff_orientation(segment + sizeof(marker_name),
+                                         segment_size - sizeof(marker_name));
+        }
+        pos += 2 + length;
+    }
+    return 1;
+}
+
+} // namespace
+
+Orientation Orientation::from_exif(int value) {
+    // EXIF values: 2, 4, 5 and 7 are mirrored, 3 is upside down, 6 and 8
+    // are turned a quarter clockwise and counterclockwise respectively
+    const int quarter_turns[] = {0, 0, 0, 2, 2, 3, 1, 1, 3};
+    const bool mirrored[] = {false, false, true, false, true,
+                             true,  false, true, false};
+    Orientation orientation;
+    if (value >= 1 && value <= 8) {
+        orientation.quarter_turns_ = quarter_turns[value];
+        orientation.mirrored_ = mirrored[value];
+    }
+    return orientation;
+}
+
+void Orientation::rotate_clockwise() {
+    quarter_turns_ = (quarter_turns_ + 1) % 4;
+}
+
+void Orientation::rotate_counterclockwise() {
+    quarter_turns_ = (quarter_turns_ + 3) % 4;
+}
+
+void Orientation::flip_horizontal() {
+    // Mirroring after a rotation equals mirroring first and rotating the
+    // other way
+    quarter_turns_ = (4 - quarter_turns_) % 4;
+    mirrored_ = !mirrored_;
+}
+
+void Orientation::flip_vertical() {
+    flip_horizontal();
+    quarter_turns_ = (quarter_turns_ + 2) % 4;
+}
+
+glm::dvec2 Orientation::apply_to_size(glm::dvec2 size) const {
+    return quarter_turns_ % 2 == 0 ? size : glm::dvec2(size.y, size.x);
+}
+
+glm::dmat4 Orientation::get_transform() const {
+    // Exact quarter turns, without rounding errors from sin and cos
+    const int cosines[] = {1, 0, -1, 0};
+    const int sines[] = {0, 1, 0, -1};
+    double c = cosines[quarter_turns_];
+    double s = sines[quarter_turns_];
+    glm::dmat4 transform(1.0);
+    // Clockwise rotation, with y pointing up (column major)
+    transform[0][0] = c;
+    transform[0][1] = -s;
+    transform[1][0] = s;
+    transform[1][1] = c;
+    if (mirrored_) {
+        transform[0] = -transform[0]; // Negate x before rotating
+    }
+    return transform;
+}
+
+std::string Orientation::get_description() const {
+    std::string description;
+    if (quarter_turns_ != 0) {
+        description = "rotated " + std::to_string(quarter_turns_ * 90);
+    }
+    if (mirrored_) {
+        description += description.empty() ? "mirrored" : ", mirrored";
+    }
+    return description;
+}
+
+int extract_exif_orientation(const unsigned char* data, size_t size) {
+    const unsigned char png_signature[]{0x89, 'P', 'N', 'G'};
+    if (size >= 8 && std::memcmp(data, png_signature, 4) == 0) {
+        return extract_png_orientation(data, size);
+    } else if (size >= 4 && data[0] == 0xff && data[1] == 0xd8) {
+        return extract_jpeg_orientation(data, size);
+    }
+    return 1;
+}
+
+} // namespace imageviewer
@@ -0,0 +1,251 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <imageviewer/ProgressivePng.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <imageviewer/Png.h>
+#include <stdexcept>
+
+namespace imageviewer {
+
+namespace {
+
+// Largest image that is decoded
+const double MAX_PIXELS = 1 << 30;
+
+// Pixels of a pass: the first one, the spacing and the block that is
+// filled until the later passes fill in the rest of it
+struct Pass {
+    int x0;
+    int y0;
+    int dx;
+    int dy;
+    int block_width;
+    int block_height;
+};
+
+const Pass ADAM7[7] = {{0, 0, 8, 8, 8, 8}, {4, 0, 8, 8, 4, 8},
+                       {0, 4, 4, 8, 4, 4}, {2, 0, 4, 4, 2, 4},
+                       {0, 2, 2, 4, 2, 2}, {1, 0, 2, 2, 1, 2},
+                       {0, 1, 1, 2, 1, 1}};
+const Pass WHOLE_IMAGE = {0, 0, 1, 1, 1, 1};
+
+// Reverses the filter of a row, given the previous row of the same pass
+void unfilter_row(int filter, const unsigned char* in,
+                  const std::vector<unsigned char>& previous,
+                  std::vector<unsigned char>& out, size_t bytes_per_pixel) {
+    for (size_t i = 0; i < out.size(); i++) {
+        int a = i >= bytes_per_pixel ? out[i - bytes_per_pixel] : 0;
+        int b = previous[i];
+        int c = i >= bytes_per_pixel ? previous[i - bytes_per_pixel] : 0;
+        int prediction;
+        switch (filter) {
+        case 0:
+            prediction = 0;
+            break;
+        case 1:
+            prediction = a;
+            break;
+        case 2:
+            prediction = b;
+            break;
+        case 3:
+            prediction = (a + b) / 2;
+            break;
+        case 4:
+            prediction = paeth(a, b, c);
+            break;
+        default:
+            throw std::runtime_error("Invalid PNG filter");
+        }
+        out[i] = static_cast<unsigned char>(in[i] + prediction);
+    }
+}
+
+} // namespace
+
+ProgressivePng::ProgressivePng()
+    : position_{sizeof(PNG_SIGNATURE)}, idat_remaining_{0}, width_{0},
+      height_{0}, bit_depth_{0}, color_type_{0}, channels_{0},
+      interlaced_{false}, pass_{0}, row_{0} {}
+
+bool ProgressivePng::update(const unsigned char* data, size_t size) {
+    int rows = get_rows();
+    int passes = get_passes();
+    while (true) {
+        if (idat_remaining_ > 0) {
+            // The image data is used as it arrives, also within a chunk
+            size_t length = std::min(idat_remaining_, size - position_);
+            if (length == 0) {
+                break;
+            }
+            inflater_.add_input(data + position_, length);
+            position_ += length;
+            idat_remaining_ -= length;
+            if (idat_remaining_ == 0) {
+                position_ += 4; // CRC
+            }
+            continue;
+        }
+        if (position_ + 8 > size) {
+            break;
+        }
+        uint32_t length = read_be32(data + position_);
+        const unsigned char* type = data + position_ + 4;
+        if (std::memcmp(type, "IDAT", 4) == 0) {
+            if (!image_) {
+                throw std::runtime_error("PNG data before the header");
+            }
+            position_ += 8;
+            idat_remaining_ = length;
+            if (length == 0) {
+                position_ += 4;
+            }
+            continue;
+        }
+        // Other chunks are used once all of it has arrived
+        if (position_ + 12 + length > size) {
+            break;
+        }
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            read_header(data + position_ + 8, length);
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            palette_.assign(data + position_ + 8,
+                            data + position_ + 8 + length);
+        }
+        position_ += 12 + length;
+    }
+    if (image_) {
+        inflater_.inflate();
+        decode_rows();
+    }
+    return get_rows() > rows || get_passes() > passes;
+}
+
+void ProgressivePng::read_header(const unsigned char* data, size_t size) {
+    if (size < 13 || image_) {
+        throw std::runtime_error("Invalid PNG header");
+    }
+    width_ = static_cast<int>(std::min(read_be32(data), 1u << 30));
+    height_ = static_cast<int>(std::min(read_be32(data + 4), 1u << 30));
+    bit_depth_ = data[8];
+    color_type_ = data[9];
+    interlaced_ = data[12] == 1;
+    // Gray, RGB, palette, gray and alpha, RGBA
+    const int channels[7] = {1, 0, 3, 1, 2, 0, 4};
+    channels_ = color_type_ < 7 ? channels[color_type_] : 0;
+    bool valid_depth =
+        bit_depth_ == 8 ||
+        (bit_depth_ == 16 && color_type_ != 3) ||
+        ((bit_depth_ == 1 || bit_depth_ == 2 || bit_depth_ == 4) &&
+         (color_type_ == 0 || color_type_ == 3));
+    if (width_ == 0 || height_ == 0 || channels_ == 0 || !valid_depth ||
+        data[10] != 0 || data[11] != 0 || data[12] > 1) {
+        throw std::runtime_error("Invalid PNG header");
+    }
+    if (static_cast<double>(width_) * height_ > MAX_PIXELS) {
+        throw std::runtime_error("PNG image too large");
+    }
+    image_ = std::make_shared<Image>(width_, height_);
+}
+
+void ProgressivePng::decode_rows() {
+    const int passes = interlaced_ ? 7 : 1;
+    const size_t bytes_per_pixel =
+        std::max(1, channels_ * bit_depth_ / 8);
+    while (pass_ < passes) {
+        const Pass& pass = interlaced_ ? ADAM7[pass_] : WHOLE_IMAGE;
+        int width = (width_ - pass.x0 + pass.dx - 1) / pass.dx;
+        int height = (height_ - pass.y0 + pass.dy - 1) / pass.dy;
+        size_t row_size =
+            (static_cast<size_t>(width) * channels_ * bit_depth_ + 7) / 8;
+        if (width == 0 || height == 0) {
+            pass_++; // Empty passes have no data
+            continue;
+        }
+        if (row_ == 0) {
+            previous_row_.assign(row_size, 0);
+            current_row_.resize(row_size);
+        }
+        while (row_ < height) {
+            if (inflater_.get_output_size() < row_size + 1) {
+                return;
+            }
+            const unsigned char* in = inflater_.get_output();
+            unfilter_row(in[0], in + 1, previous_row_, current_row_,
+                         bytes_per_pixel);
+            inflater_.take_output(row_size + 1);
+            write_row(pass.y0 + row_ * pass.dy, pass.x0, pass.dx,
+                      pass.block_width, pass.block_height, width);
+            std::swap(previous_row_, current_row_);
+            row_++;
+        }
+        pass_++;
+        row_ = 0;
+    }
+}
+
+void ProgressivePng::write_row(int y, int x0, int dx, int block_width,
+                               int block_height, int width) {
+    // Samples of the row, scaled to 8 bits like stb_image does (but not
+    // palette indices)
+    const unsigned char* row = current_row_.data();
+    const int max_value = (1 << bit_depth_) - 1;
+    auto sample = [&](int index, bool scale) -> int {
+        if (bit_depth_ == 8) {
+            return row[index];
+        } else if (bit_depth_ == 16) {
+            return row[index * 2];
+        }
+        int per_byte = 8 / bit_depth_;
+        int shift = 8 - bit_depth_ * (index % per_byte + 1);
+        int value = (row[index / per_byte] >> shift) & max_value;
+        return scale ? value * 255 / max_value : value;
+    };
+
+    unsigned char* out = image_->get_data();
+    int y_end = std::min(y + block_height, height_);
+    for (int i = 0; i < width; i++) {
+        unsigned char rgb[3] = {0, 0, 0};
+        if (color_type_ == 3) {
+            size_t index = static_cast<size_t>(sample(i, false)) * 3;
+            if (index + 3 <= palette_.size()) {
+                std::memcpy(rgb, palette_.data() + index, 3);
+            }
+        } else if (channels_ <= 2) {
+            int gray = sample(i * channels_, true);
+            rgb[0] = rgb[1] = rgb[2] = static_cast<unsigned char>(gray);
+        } else {
+            for (int c = 0; c < 3; c++) {
+                rgb[c] = static_cast<unsigned char>(sample(i * channels_ + c,
+                                                           true));
+            }
+        }
+        int x = x0 + i * dx;
+        int x_end = std::min(x + block_width, width_);
+        for (int block_y = y; block_y < y_end; block_y++) {
+            unsigned char* pixel =
+                out + (static_cast<size_t>(block_y) * width_ + x) * 3;
+            for (int block_x = x; block_x < x_end; block_x++, pixel += 3) {
+                std::memcpy(pixel, rgb, 3);
+            }
+        }
+    }
+}
+
+} // namespace imageviewer
@@ -16,14 +16,20 @@
 
 #include <imageviewer/ShaderProgram.h>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <glm/gtc/type_ptr.hpp>
+#include <imageviewer/Cache.h>
 #include <iostream>
+#include <sstream>
 
 namespace imageviewer {
 
 namespace {
 
+const char CACHE_MAGIC[8]{'I', 'V', 'P', 'R', 'O', 'G', 0, 1};
+
 std::string load_file(std::string filename) {
     std::ifstream in;
     in.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -37,6 +43,33 @@ std::string load_file(std::string filename) {
     return contents;
 }
 
+// Loads a shader file, replacing #include "file" lines with the generated
+// source by that name or the contents of that file (relative to the
+// including file)
+std::string load_source(std::string filename,
+                        const GeneratedSources& generated) {
+    const std::string directory =
+        filename.substr(0, filename.find_last_of('/') + 1);
+    const std::string directive = "#include \"";
+    std::istringstream in(load_file(filename));
+    std::string source;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, directive.size(), directive) == 0) {
+            const size_t end = line.find('"', directive.size());
+            const std::string name =
+                line.substr(directive.size(), end - directive.size());
+            auto it = generated.find(name);
+            source += it != generated.end()
+                          ? it->second
+                          : load_source(directory + name, generated);
+        } else {
+            source += line + "\n";
+        }
+    }
+    return source;
+}
+
 void load_shader_source(GLuint shader, std::string source) {
     const char* const pointers[]{source.c_str()};
     glShaderSource(shader, 1, pointers, 0);
@@ -75,6 +108,86 @@ void link_program(GLuint program) {
     check_for_gl_error();
 }
 
+// Cache file name for a linked program, derived from the sources and the
+// driver (binaries are only valid for the driver that made them). Empty if
+// the driver cannot save programs.
+std::string get_cache_file(const std::string& vertex_source,
+                           const std::string& fragment_source) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0) {
+        return "";
+    }
+    std::ostringstream key;
+    key << glGetString(GL_RENDERER) << "|" << glGetString(GL_VERSION) << "|"
+        << vertex_source << "|" << fragment_source;
+    return get_cache_file_name(key.str(), "program");
+}
+
+// True if the driver lists the format among those it can load
+bool is_binary_format_supported(GLenum format) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    if (count <= 0) {
+        return false;
+    }
+    std::vector<GLint> formats(count);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+    return std::find(formats.begin(), formats.end(),
+                     static_cast<GLint>(format)) != formats.end();
+}
+
+// Returns the program if the cached binary loads and the driver accepts it
+GLuint load_cached_program(const std::string& cache_file) {
+    std::ifstream in(cache_file, std::ios::in | std::ios::binary);
+    char magic[sizeof(CACHE_MAGIC)];
+    GLenum format = 0;
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&format), sizeof(format)) ||
+        !is_binary_format_supported(format)) {
+        return 0;
+    }
+    std::vector<char> binary{std::istreambuf_iterator<char>(in),
+                             std::istreambuf_iterator<char>()};
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(),
+                    static_cast<GLsizei>(binary.size()));
+    // Any error is consumed here, so it is not reported by the compile path
+    bool failed = false;
+    while (glGetError() != GL_NO_ERROR) {
+        failed = true;
+    }
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (failed || status != GL_TRUE) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void save_cached_program(GLuint program, const std::string& cache_file) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    check_for_gl_error();
+    if (length == 0) {
+        return;
+    }
+
+    bool written = write_cache_file(cache_file, [&](std::ostream& out) {
+        out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        out.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        out.write(binary.data(), length);
+    });
+    if (!written) {
+        std::cerr << "Failed to write program cache: " << cache_file << "\n";
+    }
+}
+
 GLint get_uniform_location(GLint program, const std::string& name) {
     const GLint location =
         glGetProgramResourceLocation(program, GL_UNIFORM, name.c_str());
@@ -87,29 +200,53 @@ GLint get_uniform_location(GLint program, const std::string& name) {
 
 } // namespace
 
-ShaderProgram::ShaderProgram() : vert_shader_{0}, frag_shader_{0} {}
+ShaderProgram::ShaderProgram()
+    : vert_shader_{0}, frag_shader_{0}, program_{0} {}
+
+ShaderProgram::ShaderProgram(std::string vertex_file, std::string fragment_file,
+                             const GeneratedSources& generated)
+    : vert_shader_{0}, frag_shader_{0}, program_{0} {
+    const std::string vertex_source = load_source(vertex_file, generated);
+    const std::string fragment_source =
+        load_source(fragment_file, generated);
+    // Compiling takes much longer than loading a binary from an earlier run
+    const std::string cache_file =
+        get_cache_file(vertex_source, fragment_source);
+    if (!cache_file.empty()) {
+        program_ = load_cached_program(cache_file);
+        if (program_ != 0) {
+            std::cout << "Loaded shader program from cache: " << cache_file
+                      << "\n";
+            return;
+        }
+    }
 
-ShaderProgram::ShaderProgram(std::string vertex_file, std::string fragment_file)
-    : vert_shader_{0}, frag_shader_{0} {
     std::cout << "Loading vertex shader " << vertex_file << "\n";
     vert_shader_ = glCreateShader(GL_VERTEX_SHADER);
-    load_shader_source(vert_shader_, load_file(vertex_file));
+    load_shader_source(vert_shader_, vertex_source);
     compile_shader(vert_shader_);
 
     std::cout << "Loading fragment shader " << fragment_file << "\n";
     frag_shader_ = glCreateShader(GL_FRAGMENT_SHADER);
-    load_shader_source(frag_shader_, load_file(fragment_file));
+    load_shader_source(frag_shader_, fragment_source);
     compile_shader(frag_shader_);
 
     std::cout << "Creating shader program\n";
     program_ = glCreateProgram();
     glAttachShader(program_, vert_shader_);
     glAttachShader(program_, frag_shader_);
+    if (!cache_file.empty()) {
+        glProgramParameteri(program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                            GL_TRUE);
+    }
     check_for_gl_error();
 
     std::cout << "Linking shader program\n";
     link_program(program_);
     std::cout << "Linked shader program\n";
+    if (!cache_file.empty()) {
+        save_cached_program(program_, cache_file);
+    }
 }
 
 ShaderProgram::~ShaderProgram() {
@@ -135,6 +272,18 @@ ShaderProgram::ShaderProgram(ShaderProgram&& other) {
 }
 
 ShaderProgram& ShaderProgram::operator=(ShaderProgram&& other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (program_ != 0) {
+        glDeleteProgram(program_);
+    }
+    if (vert_shader_ != 0) {
+        glDeleteShader(vert_shader_);
+    }
+    if (frag_shader_ != 0) {
+        glDeleteShader(frag_shader_);
+    }
     vert_shader_ = other.vert_shader_;
     frag_shader_ = other.frag_shader_;
     program_ = other.program_;
@@ -171,6 +320,13 @@ void ShaderProgram::set_uniform(const std::string& name, GLfloat value) const {
     check_for_gl_error();
 }
 
+void ShaderProgram::set_uniform(const std::string& name,
+                                const glm::mat3& matrix) const {
+    const GLint location = get_uniform_location(program_, name);
+    glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+    check_for_gl_error();
+}
+
 void ShaderProgram::set_uniform(const std::string& name,
                                 const glm::mat4& matrix) const {
     const GLint location = get_uniform_location(program_, name);
@@ -185,4 +341,19 @@ void ShaderProgram::set_uniform(const std::string& name,
     check_for_gl_error();
 }
 
+void ShaderProgram::set_uniform(const std::string& name,
+                                const glm::ivec2& vector) const {
+    const GLint location = get_uniform_location(program_, name);
+    glUniform2iv(location, 1, glm::value_ptr(vector));
+    check_for_gl_error();
+}
+
+void ShaderProgram::set_uniform(const std::string& name,
+                                const std::vector<glm::vec2>& vectors) const {
+    const GLint location = get_uniform_location(program_, name);
+    glUniform2fv(location, static_cast<GLsizei>(vectors.size()),
+                 glm::value_ptr(vectors[0]));
+    check_for_gl_error();
+}
+
 } // namespace imageviewer
@@ -67,7 +67,7 @@ SquareVertexArray& SquareVertexArray::operator=(SquareVertexArray&& other) {
     return *this;
 }
 
-void SquareVertexArray::render(const ShaderProgram& program) {
+void SquareVertexArray::render(const ShaderProgram& program, int instances) {
     const GLint attr_pos = program.get_input_location("in_position");
     glBindBuffer(GL_ARRAY_BUFFER, buffer_pos_);
     check_for_gl_error();
@@ -84,7 +84,7 @@ void SquareVertexArray::render(const ShaderProgram& program) {
     glEnableVertexAttribArray(attr_tex);
     check_for_gl_error();
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances);
     check_for_gl_error();
 }
 
@@ -0,0 +1,52 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/StartupTrace.h>
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+
+namespace imageviewer {
+
+namespace {
+
+// Set before main() runs
+const std::chrono::steady_clock::time_point START =
+    std::chrono::steady_clock::now();
+
+std::mutex trace_mutex;
+bool trace_ended = false;
+
+} // namespace
+
+void trace_startup(const std::string& phase) {
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - START;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!trace_ended) {
+        std::cout << "Startup: " << phase << " at " << elapsed.count()
+                  << " ms\n";
+    }
+}
+
+void end_startup_trace() {
+    trace_startup("First frame");
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_ended = true;
+}
+
+} // namespace imageviewer
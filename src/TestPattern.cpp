@@ -0,0 +1,89 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/TestPattern.h>
+
+#include <cmath>
+
+namespace imageviewer {
+
+namespace {
+
+const double PI = 3.14159265358979;
+
+unsigned char to_byte(double value) {
+    return static_cast<unsigned char>(
+        std::round(std::fmin(std::fmax(value, 0.0), 1.0) * 255.0));
+}
+
+// Circular zone plate reaching the Nyquist frequency at the edges
+void zone_plate(Image& image, int x, int y, unsigned char* pixel) {
+    double size = image.get_width();
+    double dx = x + 0.5 - size / 2.0;
+    double dy = y + 0.5 - size / 2.0;
+    double v = 0.5 + 0.5 * std::cos(PI * (dx * dx + dy * dy) / size);
+    pixel[0] = pixel[1] = pixel[2] = to_byte(v);
+}
+
+// Slanted hard edge, plus one and two pixel wide lines
+void edges(Image& image, int x, int y, unsigned char* pixel) {
+    double size = image.get_width();
+    double v = (x - size / 2.0) * std::cos(0.1) +
+                       (y - size / 2.0) * std::sin(0.1) <
+                   0.0
+                   ? 0.0
+                   : 1.0;
+    int lines_start = image.get_height() / 2 + 16;
+    if (y == lines_start || y == lines_start + 4 || y == lines_start + 5) {
+        v = 1.0 - v;
+    }
+    pixel[0] = pixel[1] = pixel[2] = to_byte(v);
+}
+
+// Smooth color ramps, to catch banding and sRGB conversion errors
+void gradient(Image& image, int x, int y, unsigned char* pixel) {
+    double u = (x + 0.5) / image.get_width();
+    double v = (y + 0.5) / image.get_height();
+    pixel[0] = to_byte(u);
+    pixel[1] = to_byte(v);
+    pixel[2] = to_byte(1.0 - 0.5 * (u + v));
+}
+
+} // namespace
+
+Image make_test_pattern(TestPattern pattern, int size) {
+    Image image(size, size);
+    unsigned char* data = image.get_data();
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            unsigned char* pixel = data + (y * size + x) * 3;
+            switch (pattern) {
+            case TestPattern::ZONE_PLATE:
+                zone_plate(image, x, y, pixel);
+                break;
+            case TestPattern::EDGES:
+                edges(image, x, y, pixel);
+                break;
+            case TestPattern::GRADIENT:
+                gradient(image, x, y, pixel);
+                break;
+            }
+        }
+    }
+    return image;
+}
+
+} // namespace imageviewer
@@ -15,58 +15,143 @@
  */
 
 #include <imageviewer/Texture.h>
+#include <algorithm>
+#include <imageviewer/GpuMemory.h>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
 namespace imageviewer {
 
-Texture::Texture(const Image& image) : width_{0}, height_{0} {
-    glGenTextures(1, &texture_);
-    check_for_gl_error();
+Texture::Texture(const Image& image)
+    : texture_{0}, width_{image.get_width()}, height_{image.get_height()},
+      evictable_{false} {
+    // Drivers keep RGB8 texels in four bytes
+    allocate(GL_RGB8, static_cast<size_t>(width_) * height_ * 4);
     std::cout << "Generated texture: " << texture_ << "\n";
 
-    glBindTexture(GL_TEXTURE_2D, texture_);
-    check_for_gl_error();
-
     glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
     glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glPixelStorei(GL_UNPACK_ROW_LENGTH, image.get_width());
     glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, image.get_height());
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, image.get_width(),
-                 image.get_height(), 0, GL_RGB, GL_UNSIGNED_BYTE,
-                 image.get_data());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RGB,
+                    GL_UNSIGNED_BYTE, image.get_data());
+    reset_unpack_state();
     check_for_gl_error();
-    width_ = image.get_width();
-    height_ = image.get_height();
     // glGenerateMipmap(GL_TEXTURE_2D);
     // check_for_gl_error();
     std::cout << "Uploaded texture: " << texture_ << "\n";
     std::cout << "Texture: " << width_ << " x " << height_ << "\n";
 }
 
+Texture::Texture(const CompressedImage& image)
+    : texture_{0}, width_{image.get_width()}, height_{image.get_height()},
+      evictable_{false} {
+    allocate(GL_COMPRESSED_RGB8_ETC2, image.get_size());
+    std::cout << "Generated texture: " << texture_ << "\n";
+
+    // Upload in bands of block rows, to keep each transfer reasonably small
+    const int band_rows = 64;
+    const size_t row_size = static_cast<size_t>(image.get_block_columns()) * 8;
+    for (int row = 0; row < image.get_block_rows(); row += band_rows) {
+        int rows = std::min(band_rows, image.get_block_rows() - row);
+        int y = row * 4;
+        int height = std::min(rows * 4, image.get_height() - y);
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, image.get_width(),
+                                  height, GL_COMPRESSED_RGB8_ETC2,
+                                  static_cast<GLsizei>(row_size * rows),
+                                  image.get_data() + row_size * row);
+        check_for_gl_error();
+    }
+    std::cout << "Uploaded compressed texture: " << texture_ << " ("
+              << image.get_size() / 1e6 << " MB instead of "
+              << static_cast<double>(width_) * height_ * 3 / 1e6 << " MB)\n";
+}
+
+Texture::Texture(int width, int height)
+    : texture_{0}, width_{width}, height_{height}, evictable_{false} {
+    allocate(GL_RGB8, static_cast<size_t>(width) * height * 4);
+
+    // The initial contents are undefined, so they are cleared in bands
+    const int band_rows = 64;
+    std::vector<unsigned char> zeros(static_cast<size_t>(width) * 3 *
+                                     std::min(band_rows, height));
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    for (int y = 0; y < height; y += band_rows) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width,
+                        std::min(band_rows, height - y), GL_RGB,
+                        GL_UNSIGNED_BYTE, zeros.data());
+    }
+    reset_unpack_state();
+    check_for_gl_error();
+    std::cout << "Generated texture: " << texture_ << " (" << width_ << " x "
+              << height_ << ")\n";
+}
+
 Texture::Texture(Texture&& other) {
     texture_ = other.texture_;
     width_ = other.width_;
     height_ = other.height_;
+    evictable_ = other.evictable_;
     other.texture_ = 0;
+    if (evictable_) {
+        set_evictable(); // Released through this object from now on
+    }
 }
 
 Texture& Texture::operator=(Texture&& other) {
+    if (texture_ != other.texture_) {
+        release();
+    }
     texture_ = other.texture_;
     width_ = other.width_;
     height_ = other.height_;
+    evictable_ = other.evictable_;
     other.texture_ = 0;
+    if (evictable_) {
+        set_evictable();
+    }
     return *this;
 }
 
 Texture::~Texture() {
     if (texture_ != 0) {
-        std::cout << "Deleting texture: " << texture_ << "\n";
-        glDeleteTextures(1, &texture_);
+        release();
         check_for_gl_error();
     }
 }
 
+void Texture::update(const Image& image) {
+    if (image.get_width() != width_ || image.get_height() != height_) {
+        throw std::runtime_error("Texture update with a different size");
+    }
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image.get_width());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RGB,
+                    GL_UNSIGNED_BYTE, image.get_data());
+    reset_unpack_state();
+    check_for_gl_error();
+}
+
+void Texture::update(const Image& image, int x, int y, int width,
+                     int height) {
+    if (image.get_width() != width_ || image.get_height() != height_) {
+        throw std::runtime_error("Texture update with a different size");
+    }
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image.get_width());
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGB,
+                    GL_UNSIGNED_BYTE, image.get_data());
+    reset_unpack_state();
+    check_for_gl_error();
+}
+
 void Texture::bind_to_unit(GLenum texture_unit) {
     glActiveTexture(texture_unit);
     check_for_gl_error();
@@ -77,6 +162,38 @@ void Texture::bind_to_unit(GLenum texture_unit) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
     check_for_gl_error();
+    GpuMemory::shared().touch(texture_);
+}
+
+void Texture::set_evictable() {
+    evictable_ = true;
+    GpuMemory::shared().set_release(texture_, [this] { release(); });
+}
+
+void Texture::allocate(GLenum internal_format, size_t bytes) {
+    glGenTextures(1, &texture_);
+    check_for_gl_error();
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    try {
+        GpuMemory::shared().allocate(bytes, [&] {
+            glTexStorage2D(GL_TEXTURE_2D, 1, internal_format, width_,
+                           height_);
+        });
+    } catch (...) {
+        glDeleteTextures(1, &texture_);
+        texture_ = 0;
+        throw;
+    }
+    GpuMemory::shared().add(texture_, bytes);
+}
+
+void Texture::release() {
+    if (texture_ != 0) {
+        std::cout << "Deleting texture: " << texture_ << "\n";
+        GpuMemory::shared().remove(texture_);
+        glDeleteTextures(1, &texture_);
+        texture_ = 0;
+    }
 }
 
 } // namespace imageviewer
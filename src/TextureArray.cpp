@@ -0,0 +1,150 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/TextureArray.h>
+#include <algorithm>
+#include <imageviewer/GpuMemory.h>
+#include <iostream>
+
+namespace imageviewer {
+
+TextureArray::TextureArray(
+    const std::vector<std::shared_ptr<const Image>>& images)
+    : texture_{0}, width_{0}, height_{0},
+      layers_{static_cast<int>(images.size())}, evictable_{false} {
+    for (const auto& image : images) {
+        width_ = std::max(width_, image->get_width());
+        height_ = std::max(height_, image->get_height());
+    }
+    const GLsizei layers = layers_;
+    allocate();
+
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (GLsizei layer = 0; layer < layers; layer++) {
+        const Image& image = *images[layer];
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, image.get_width());
+        glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, image.get_height());
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, image.get_width(),
+                        image.get_height(), 1, GL_RGB, GL_UNSIGNED_BYTE,
+                        image.get_data());
+        check_for_gl_error();
+    }
+    reset_unpack_state();
+    std::cout << "Uploaded texture array: " << texture_ << " (" << layers
+              << " x " << width_ << " x " << height_ << ")\n";
+}
+
+TextureArray::TextureArray(int width, int height, int layers)
+    : texture_{0}, width_{width}, height_{height}, layers_{layers},
+      evictable_{false} {
+    allocate();
+    std::cout << "Created texture array: " << texture_ << " (" << layers
+              << " x " << width_ << " x " << height_ << ")\n";
+}
+
+TextureArray::TextureArray(TextureArray&& other) {
+    texture_ = other.texture_;
+    width_ = other.width_;
+    height_ = other.height_;
+    layers_ = other.layers_;
+    evictable_ = other.evictable_;
+    other.texture_ = 0;
+    if (evictable_) {
+        set_evictable(); // Released through this object from now on
+    }
+}
+
+TextureArray& TextureArray::operator=(TextureArray&& other) {
+    if (texture_ != other.texture_) {
+        release();
+    }
+    texture_ = other.texture_;
+    width_ = other.width_;
+    height_ = other.height_;
+    layers_ = other.layers_;
+    evictable_ = other.evictable_;
+    other.texture_ = 0;
+    if (evictable_) {
+        set_evictable();
+    }
+    return *this;
+}
+
+TextureArray::~TextureArray() {
+    if (texture_ != 0) {
+        release();
+        check_for_gl_error();
+    }
+}
+
+void TextureArray::update_layer(int layer, const Image& image) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image.get_width());
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, image.get_height());
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, image.get_width(),
+                    image.get_height(), 1, GL_RGB, GL_UNSIGNED_BYTE,
+                    image.get_data());
+    reset_unpack_state();
+    check_for_gl_error();
+}
+
+void TextureArray::bind_to_unit(GLenum texture_unit) {
+    glActiveTexture(texture_unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    check_for_gl_error();
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    check_for_gl_error();
+    GpuMemory::shared().touch(texture_);
+}
+
+void TextureArray::set_evictable() {
+    evictable_ = true;
+    GpuMemory::shared().set_release(texture_, [this] { release(); });
+}
+
+void TextureArray::allocate() {
+    // Drivers keep RGB8 texels in four bytes
+    const size_t bytes = static_cast<size_t>(width_) * height_ * 4 * layers_;
+    glGenTextures(1, &texture_);
+    check_for_gl_error();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    try {
+        GpuMemory::shared().allocate(bytes, [&] {
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGB8, width_, height_,
+                           layers_);
+        });
+    } catch (...) {
+        glDeleteTextures(1, &texture_);
+        texture_ = 0;
+        throw;
+    }
+    GpuMemory::shared().add(texture_, bytes);
+}
+
+void TextureArray::release() {
+    if (texture_ != 0) {
+        std::cout << "Deleting texture array: " << texture_ << "\n";
+        GpuMemory::shared().remove(texture_);
+        glDeleteTextures(1, &texture_);
+        texture_ = 0;
+    }
+}
+
+} // namespace imageviewer
@@ -0,0 +1,195 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/TiledImage.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <imageviewer/ThreadPool.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace imageviewer {
+
+namespace {
+
+// Smaller images are simply decoded as a whole
+const double MIN_TILED_PIXELS = 64e6;
+const int MIN_TILED_SIZE = 16384;
+
+// Rows per task when sampling the preview in parallel
+const int BAND_ROWS = 32;
+
+// Reads the next number of a PNM header, skipping whitespace and comments
+bool read_header_value(const unsigned char* data, size_t size, size_t& pos,
+                       int& value) {
+    while (pos < size && (std::isspace(data[pos]) || data[pos] == '#')) {
+        if (data[pos] == '#') {
+            while (pos < size && data[pos] != '\n') {
+                pos++;
+            }
+        } else {
+            pos++;
+        }
+    }
+    if (pos >= size || !std::isdigit(data[pos])) {
+        return false;
+    }
+    long long number = 0;
+    while (pos < size && std::isdigit(data[pos]) && number <= 1 << 30) {
+        number = number * 10 + (data[pos++] - '0');
+    }
+    value = static_cast<int>(number);
+    return number > 0 && number <= 1 << 30;
+}
+
+} // namespace
+
+std::unique_ptr<TiledImage> TiledImage::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size < 16) {
+        close(fd);
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    const unsigned char* data = static_cast<const unsigned char*>(mapping);
+
+    int width = 0;
+    int height = 0;
+    int max_value = 0;
+    size_t pos = 2;
+    bool valid = data[0] == 'P' && (data[1] == '5' || data[1] == '6') &&
+                 read_header_value(data, size, pos, width) &&
+                 read_header_value(data, size, pos, height) &&
+                 read_header_value(data, size, pos, max_value) &&
+                 max_value <= 255 && pos < size && std::isspace(data[pos]);
+    int channels = data[1] == '6' ? 3 : 1;
+    pos++; // A single whitespace character before the samples
+    bool large = static_cast<double>(width) * height >= MIN_TILED_PIXELS ||
+                 std::max(width, height) > MIN_TILED_SIZE;
+    if (!valid || !large ||
+        static_cast<double>(width) * height * channels > size - pos) {
+        munmap(mapping, size);
+        return nullptr;
+    }
+    std::cout << "Mapped " << filename << " (" << width << "x" << height
+              << "), decoding by region\n";
+    return std::unique_ptr<TiledImage>(
+        new TiledImage(data, size, pos, width, height, channels));
+}
+
+TiledImage::TiledImage(const unsigned char* mapping, size_t mapping_size,
+                       size_t data_offset, int width, int height,
+                       int channels)
+    : mapping_{mapping}, mapping_size_{mapping_size},
+      data_{mapping + data_offset}, width_{width}, height_{height},
+      channels_{channels} {}
+
+TiledImage::~TiledImage() {
+    munmap(const_cast<unsigned char*>(mapping_), mapping_size_);
+}
+
+std::shared_ptr<const Image> TiledImage::make_preview(int max_size) const {
+    // Average each step x step block, so that the preview is not aliased
+    int step = (std::max(width_, height_) + max_size - 1) / max_size;
+    int width = (width_ + step - 1) / step;
+    int height = (height_ + step - 1) / step;
+    auto preview = std::make_shared<Image>(width, height);
+    unsigned char* out = preview->get_data();
+    size_t bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    ThreadPool::shared().parallel_for(bands, [&](size_t band) {
+        int end = std::min(static_cast<int>(band + 1) * BAND_ROWS, height);
+        for (int row = static_cast<int>(band) * BAND_ROWS; row < end; row++) {
+            average_blocks(row * step, step,
+                           out + static_cast<size_t>(row) * width * 3);
+        }
+    });
+    std::cout << "Preview: " << width << "x" << height << " (1/" << step
+              << ")\n";
+    return preview;
+}
+
+Image TiledImage::decode_region(int x, int y, int width, int height) const {
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 || x + width > width_ ||
+        y + height > height_) {
+        throw std::runtime_error("Region outside the image");
+    }
+    // Regions are about the size of the window, and this runs on the thread
+    // pool already, so the rows are copied on this thread
+    Image region(width, height);
+    for (int row = 0; row < height; row++) {
+        read_row(x, y + row, width,
+                 region.get_data() + static_cast<size_t>(row) * width * 3);
+    }
+    return region;
+}
+
+void TiledImage::get_pixel(int x, int y, unsigned char rgb[3]) const {
+    read_row(x, y, 1, rgb);
+}
+
+void TiledImage::read_row(int x, int y, int width, unsigned char* out) const {
+    const unsigned char* in = data_ +
+                              (static_cast<size_t>(y) * width_ + x) * channels_;
+    if (channels_ == 3) {
+        std::memcpy(out, in, static_cast<size_t>(width) * 3);
+        return;
+    }
+    for (int i = 0; i < width; i++, in++, out += 3) {
+        out[0] = out[1] = out[2] = in[0];
+    }
+}
+
+void TiledImage::average_blocks(int y, int step, unsigned char* out) const {
+    // Blocks at the right and bottom edges may be smaller
+    const int rows = std::min(step, height_ - y);
+    const int blocks = (width_ + step - 1) / step;
+    std::vector<unsigned int> sums(static_cast<size_t>(blocks) * 3, 0);
+    for (int row = y; row < y + rows; row++) {
+        const unsigned char* in =
+            data_ + static_cast<size_t>(row) * width_ * channels_;
+        for (int x = 0; x < width_; x++, in += channels_) {
+            unsigned int* sum = &sums[static_cast<size_t>(x / step) * 3];
+            sum[0] += in[0];
+            sum[1] += in[channels_ == 3 ? 1 : 0];
+            sum[2] += in[channels_ == 3 ? 2 : 0];
+        }
+    }
+    for (int block = 0; block < blocks; block++, out += 3) {
+        const unsigned int count = rows * std::min(step, width_ - block * step);
+        for (int c = 0; c < 3; c++) {
+            out[c] = static_cast<unsigned char>(
+                (sums[block * 3 + c] + count / 2) / count);
+        }
+    }
+}
+
+} // namespace imageviewer
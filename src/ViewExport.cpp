@@ -0,0 +1,169 @@
+/**
+ * Copyright 2019 Hampus Wessman
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageviewer/ViewExport.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <imageviewer/ImageWriter.h>
+#include <imageviewer/ThreadPool.h>
+#include <iostream>
+
+namespace imageviewer {
+
+namespace {
+
+// The smallest maximum renderbuffer size allowed by OpenGL ES 3
+const int TILE_SIZE = 2048;
+
+} // namespace
+
+ViewExport::ViewExport(const std::string& filename, glm::ivec2 size)
+    : filename_{filename}, size_{size}, next_tile_{0}, tiles_done_{0} {
+    for (int y = 0; y < size_.y; y += TILE_SIZE) {
+        for (int x = 0; x < size_.x; x += TILE_SIZE) {
+            tiles_.emplace_back(x, y, std::min(TILE_SIZE, size_.x - x),
+                                std::min(TILE_SIZE, size_.y - y));
+        }
+    }
+    framebuffer_ = Framebuffer(std::min(TILE_SIZE, size_.x),
+                               std::min(TILE_SIZE, size_.y));
+    output_ = std::make_unique<Image>(size_.x, size_.y);
+    std::cout << "Exporting the view to " << filename_ << " (" << size_.x
+              << " x " << size_.y << ", " << tiles_.size() << " tiles)\n";
+}
+
+ViewExport::~ViewExport() {
+    for (Readback& readback : readbacks_) {
+        glDeleteSync(readback.fence);
+        free_buffers_.push_back(readback.buffer);
+    }
+    if (!free_buffers_.empty()) {
+        glDeleteBuffers(static_cast<GLsizei>(free_buffers_.size()),
+                        free_buffers_.data());
+    }
+    if (encoding_.valid()) {
+        encoding_.wait(); // It writes from output_
+    }
+}
+
+glm::dmat4 ViewExport::begin_tile() {
+    const glm::ivec4& tile = tiles_[next_tile_];
+    framebuffer_.bind();
+    glViewport(0, 0, tile.z, tile.w);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Scale the output up so that the tile covers -1 to 1. OpenGL counts
+    // rows from the bottom.
+    glm::dvec2 tile_size(tile.z, tile.w);
+    glm::dvec2 tile_min(tile.x, size_.y - tile.y - tile.w);
+    glm::dvec2 scale = glm::dvec2(size_) / tile_size;
+    glm::dvec2 offset = (glm::dvec2(size_) - 2.0 * tile_min) / tile_size - 1.0;
+    glm::dmat4 transform =
+        glm::translate(glm::dmat4(1.0), glm::dvec3(offset, 0.0));
+    return glm::scale(transform, glm::dvec3(scale, 1.0));
+}
+
+void ViewExport::end_tile() {
+    const glm::ivec4& tile = tiles_[next_tile_++];
+    Readback readback{0, 0, tile};
+    if (free_buffers_.empty()) {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER,
+                     static_cast<GLsizeiptr>(framebuffer_.get_width()) *
+                         framebuffer_.get_height() * 4,
+                     nullptr, GL_STREAM_READ);
+    } else {
+        readback.buffer = free_buffers_.back();
+        free_buffers_.pop_back();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    }
+
+    // Into the buffer, without waiting for the drawing to finish
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, tile.z, tile.w, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    check_for_gl_error();
+    readbacks_.push_back(readback);
+}
+
+bool ViewExport::update() {
+    for (auto it = readbacks_.begin(); it != readbacks_.end();) {
+        GLenum status = glClientWaitSync(it->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED &&
+            status != GL_CONDITION_SATISFIED) {
+            ++it;
+            continue;
+        }
+        glDeleteSync(it->fence);
+
+        // Drop alpha and flip the rows into place in the output
+        const glm::ivec4& tile = it->tile;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, it->buffer);
+        auto rgba = static_cast<const unsigned char*>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                             static_cast<GLsizeiptr>(tile.z) * tile.w * 4,
+                             GL_MAP_READ_BIT));
+        check_for_gl_error();
+        for (int y = 0; y < tile.w; y++) {
+            const unsigned char* src =
+                rgba + static_cast<size_t>(tile.w - 1 - y) * tile.z * 4;
+            unsigned char* dst =
+                output_->get_data() +
+                (static_cast<size_t>(tile.y + y) * size_.x + tile.x) * 3;
+            for (int x = 0; x < tile.z; x++) {
+                std::memcpy(dst + x * 3, src + x * 4, 3);
+            }
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        free_buffers_.push_back(it->buffer);
+        it = readbacks_.erase(it);
+        tiles_done_++;
+    }
+
+    if (tiles_done_ < tiles_.size()) {
+        return false;
+    }
+    if (!encoding_.valid()) {
+        Image* output = output_.get();
+        std::string filename = filename_;
+        encoding_ = ThreadPool::shared().submit([output, filename] {
+            auto start = std::chrono::steady_clock::now();
+            try {
+                write_png(filename, output->get_width(), output->get_height(),
+                          output->get_data());
+            } catch (const std::exception& e) {
+                std::cerr << "Failed to write " << filename << ": "
+                          << e.what() << "\n";
+                return;
+            }
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::cout << "Exported the view to " << filename << " ("
+                      << elapsed.count() << " ms to encode)\n";
+            glfwPostEmptyEvent();
+        });
+    }
+    return encoding_.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+}
+
+} // namespace imageviewer
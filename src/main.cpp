@@ -16,12 +16,31 @@
 
 #include <imageviewer/glfw.h>
 
+#include <cstdlib>
+#include <filesystem>
+#include <future>
 #include <glm/vec2.hpp>
+#include <imageviewer/ContactSheet.h>
+#include <imageviewer/GoldenTest.h>
+#include <imageviewer/GpuMemory.h>
 #include <imageviewer/ImageViewer.h>
+#include <imageviewer/MetadataIndex.h>
+#include <imageviewer/StartupTrace.h>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
+using imageviewer::ColorProfile;
+using imageviewer::ContactSheet;
+using imageviewer::end_startup_trace;
+using imageviewer::GpuMemory;
 using imageviewer::ImageViewer;
+using imageviewer::load_image_async;
+using imageviewer::LoadedImage;
+using imageviewer::MetadataIndex;
+using imageviewer::run_golden_tests;
+using imageviewer::trace_startup;
 
 namespace {
 
@@ -41,21 +60,45 @@ void GLAPIENTRY gl_message_callback(GLenum source, GLenum type, GLuint id,
             severity, message);
 }
 
+// What the window shows: the image viewer, if open, and otherwise the
+// contact sheet of the directory that was opened
+struct Views {
+    std::unique_ptr<ContactSheet> sheet;
+    std::unique_ptr<ImageViewer> viewer;
+};
+
+Views& get_views(GLFWwindow* window) {
+    return *static_cast<Views*>(glfwGetWindowUserPointer(window));
+}
+
 void window_size_callback(GLFWwindow* window, int width, int height) {
-    auto viewer = static_cast<ImageViewer*>(glfwGetWindowUserPointer(window));
-    viewer->set_size(width, height);
+    Views& views = get_views(window);
+    if (views.viewer) {
+        views.viewer->set_size(width, height);
+    } else {
+        views.sheet->set_size(width, height);
+    }
 }
 
-void init_window_size(ImageViewer& viewer, GLFWwindow* window) {
+template <typename View> void init_window_size(View& view, GLFWwindow* window) {
     int width, height;
     glfwGetWindowSize(window, &width, &height);
-    viewer.set_size(width, height);
+    view.set_size(width, height);
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action,
                   int mods) {
-    auto viewer = static_cast<ImageViewer*>(glfwGetWindowUserPointer(window));
-    viewer->key_event(key, action);
+    Views& views = get_views(window);
+    if (views.viewer && views.sheet && key == GLFW_KEY_ESCAPE &&
+        action == GLFW_PRESS) {
+        // Back to the contact sheet
+        views.viewer.reset();
+        init_window_size(*views.sheet, window);
+    } else if (views.viewer) {
+        views.viewer->key_event(key, action);
+    } else {
+        views.sheet->key_event(key, action);
+    }
 }
 
 glm::dvec2 get_mouse_pos(GLFWwindow* window) {
@@ -65,29 +108,155 @@ glm::dvec2 get_mouse_pos(GLFWwindow* window) {
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
-    auto viewer = static_cast<ImageViewer*>(glfwGetWindowUserPointer(window));
-    viewer->scroll_event(yoffset, get_mouse_pos(window));
+    Views& views = get_views(window);
+    if (views.viewer) {
+        views.viewer->scroll_event(yoffset, get_mouse_pos(window));
+    } else {
+        views.sheet->scroll_event(yoffset);
+    }
 }
 
 void mouse_button_callback(GLFWwindow* window, int button, int action,
                            int mods) {
-    auto viewer = static_cast<ImageViewer*>(glfwGetWindowUserPointer(window));
-    viewer->mouse_button_event(button, action, get_mouse_pos(window));
+    Views& views = get_views(window);
+    if (views.viewer) {
+        views.viewer->mouse_button_event(button, action,
+                                         get_mouse_pos(window));
+    } else {
+        views.sheet->mouse_button_event(button, action,
+                                        get_mouse_pos(window));
+    }
 }
 
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
-    auto viewer = static_cast<ImageViewer*>(glfwGetWindowUserPointer(window));
-    viewer->mouse_move_event(glm::dvec2(xpos, ypos));
+    Views& views = get_views(window);
+    if (views.viewer) {
+        views.viewer->mouse_move_event(glm::dvec2(xpos, ypos));
+    }
+}
+
+struct Options {
+    std::string filename;
+    std::vector<std::string> compare_filenames;
+    std::string golden_dir;
+    bool golden_update = false;
+    std::string display_profile;
+    bool compressed = false;
+    double export_scale = 4.0;
+    double gpu_budget = 0.0;    // MB, 0 for the default
+    double filter_budget = 0.0; // ms, 0 for the default
+    std::string index_dir;
+};
+
+void print_usage_and_exit() {
+    std::cerr << "Usage: imageviewer [options] {image file} [image file...]\n"
+              << "       imageviewer [options] {directory}\n"
+              << "       imageviewer [options] {- | fifo | unix:socket}\n"
+              << "       imageviewer --golden-test {golden dir}\n"
+              << "       imageviewer --golden-update {golden dir}\n"
+              << "       imageviewer --index {directory}\n"
+              << "Options:\n"
+              << "  --display-profile {icc file}  Display color profile\n"
+              << "  --compressed                  ETC2 compressed textures\n"
+              << "  --export-scale {factor}       Size of exports (P key)\n"
+              << "  --gpu-budget {MB}             GPU memory for textures\n"
+              << "  --filter-budget {ms}          Time for the Auto filter\n";
+    exit(2);
+}
+
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg{argv[i]};
+        const bool has_value = i + 1 < argc;
+        if ((arg == "--golden-test" || arg == "--golden-update") &&
+            has_value) {
+            options.golden_dir = argv[++i];
+            options.golden_update = arg == "--golden-update";
+        } else if (arg == "--index" && has_value) {
+            options.index_dir = argv[++i];
+        } else if (arg == "--display-profile" && has_value) {
+            options.display_profile = argv[++i];
+        } else if (arg == "--compressed") {
+            options.compressed = true;
+        } else if (arg == "--export-scale" && has_value) {
+            options.export_scale = std::atof(argv[++i]);
+            if (options.export_scale <= 0.0) {
+                print_usage_and_exit();
+            }
+        } else if (arg == "--filter-budget" && has_value) {
+            options.filter_budget = std::atof(argv[++i]);
+            if (options.filter_budget <= 0.0) {
+                print_usage_and_exit();
+            }
+        } else if (arg == "--gpu-budget" && has_value) {
+            options.gpu_budget = std::atof(argv[++i]);
+            if (options.gpu_budget <= 0.0) {
+                print_usage_and_exit();
+            }
+        } else if (arg.rfind("--", 0) != 0 && options.filename.empty()) {
+            options.filename = arg;
+        } else if (arg.rfind("--", 0) != 0) {
+            options.compare_filenames.push_back(arg);
+        } else {
+            print_usage_and_exit();
+        }
+    }
+    const int modes = !options.filename.empty() +
+                      !options.golden_dir.empty() + !options.index_dir.empty();
+    if (modes != 1) {
+        print_usage_and_exit();
+    }
+    return options;
+}
+
+// Lists the images in a directory from the metadata index
+void print_index(const std::string& directory) {
+    MetadataIndex index(directory);
+    for (const imageviewer::ImageInfo& info : index.get_images()) {
+        std::cout << info.filename << ": "
+                  << imageviewer::get_format_name(info.format) << " "
+                  << info.width << "x" << info.height << ", "
+                  << info.channels << " x " << info.bits_per_channel
+                  << " bits, orientation " << info.orientation << "\n";
+    }
 }
 
 } // namespace
 
-void main_loop(const std::string& filename, GLFWwindow* window) {
-    ImageViewer viewer(filename, window);
+std::unique_ptr<ImageViewer> open_viewer(const Options& options,
+                                         std::future<LoadedImage> loading,
+                                         GLFWwindow* window) {
+    auto viewer = std::make_unique<ImageViewer>(std::move(loading), window);
+    if (!options.display_profile.empty()) {
+        viewer->set_display_profile(
+            ColorProfile::from_icc_file(options.display_profile));
+    }
+    viewer->set_compressed(options.compressed);
+    viewer->set_export_scale(options.export_scale);
+    if (options.filter_budget > 0.0) {
+        viewer->set_filter_budget(options.filter_budget);
+    }
+    init_window_size(*viewer, window);
+    return viewer;
+}
+
+// Shows the image being loaded, or else the contact sheet
+void main_loop(const Options& options, std::future<LoadedImage> loading,
+               GLFWwindow* window) {
+    Views views;
+    if (!loading.valid()) {
+        views.sheet = std::make_unique<ContactSheet>(options.filename, window);
+        init_window_size(*views.sheet, window);
+    } else {
+        views.viewer = open_viewer(options, std::move(loading), window);
+        for (const std::string& filename : options.compare_filenames) {
+            views.viewer->add_compare_image(filename);
+        }
+    }
 
-    glfwSetWindowUserPointer(window, &viewer);
+    glfwSetWindowUserPointer(window, &views);
     glfwSetWindowSizeCallback(window, window_size_callback);
-    init_window_size(viewer, window);
     glfwSetKeyCallback(window, key_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
@@ -95,29 +264,67 @@ void main_loop(const std::string& filename, GLFWwindow* window) {
 
     double last_time = glfwGetTime();
     while (!glfwWindowShouldClose(window)) {
+        if (!views.viewer) {
+            const std::string chosen = views.sheet->take_chosen();
+            if (!chosen.empty()) {
+                try {
+                    views.viewer =
+                        open_viewer(options, load_image_async(chosen), window);
+                } catch (const std::exception& e) {
+                    std::cerr << "Failed to open " << chosen << ": "
+                              << e.what() << "\n";
+                }
+            }
+        }
+
         double time = glfwGetTime();
-        viewer.render(time - last_time);
+        if (views.viewer) {
+            views.viewer->render(time - last_time);
+        } else {
+            views.sheet->render();
+        }
         last_time = time;
 
         glfwSwapInterval(1);
         glfwSwapBuffers(window);
-        glfwWaitEvents();
+        GpuMemory::shared().next_frame();
+        end_startup_trace();
+        double timeout = views.viewer
+                             ? views.viewer->get_time_to_next_frame()
+                             : views.sheet->get_time_to_next_frame();
+        if (timeout < 0.0) {
+            glfwWaitEvents();
+        } else {
+            glfwWaitEventsTimeout(timeout);
+        }
     }
+    glfwSetWindowUserPointer(window, nullptr);
 }
 
 int main(int argc, char* argv[]) {
     std::cout << "Starting image viewer...\n";
 
-    if (argc != 2) {
-        std::cerr << "Usage: imageviewer {image file}\n";
-        exit(2);
+    const Options options = parse_options(argc, argv);
+    if (!options.index_dir.empty()) {
+        print_index(options.index_dir);
+        return 0;
+    }
+    const bool golden_test = !options.golden_dir.empty();
+
+    // Decoding takes the longest, so it starts first and the window, GL
+    // context and shaders are made meanwhile
+    std::future<LoadedImage> loading;
+    if (!golden_test && !(std::filesystem::is_directory(options.filename) &&
+                          options.compare_filenames.empty())) {
+        loading = load_image_async(options.filename);
+        trace_startup("Started decoding");
     }
-    const std::string filename{argv[1]};
 
     if (!glfwInit()) {
         std::cerr << "Failed to init GLFW\n";
         exit(1);
     }
+    trace_startup("Initialized GLFW");
 
     glfwSetErrorCallback(error_callback);
 
@@ -125,6 +332,10 @@ int main(int argc, char* argv[]) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
     glfwWindowHint(GLFW_DOUBLEBUFFER, GLFW_TRUE);
+    if (golden_test) {
+        // Rendering happens offscreen, so the window is never shown
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
     GLFWwindow* window = glfwCreateWindow(640, 480, "Image viewer", NULL, NULL);
     if (!window) {
         std::cerr << "Failed to create a window\n";
@@ -132,8 +343,11 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
+    trace_startup("Created the window");
+
     glfwMakeContextCurrent(window);
     gladLoadGLES2Loader((GLADloadproc)glfwGetProcAddress);
+    trace_startup("Loaded GL");
 
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback(gl_message_callback, 0);
@@ -141,12 +355,24 @@ int main(int argc, char* argv[]) {
     int max_texture_size = 0;
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
     std::cout << "Max texture size: " << max_texture_size << "\n";
+    if (options.gpu_budget > 0.0) {
+        GpuMemory::shared().set_budget(
+            static_cast<size_t>(options.gpu_budget * 1024 * 1024));
+    }
 
-    main_loop(filename, window);
+    int status = 0;
+    if (golden_test) {
+        status = run_golden_tests(window, options.golden_dir,
+                                  options.golden_update) == 0
+                     ? 0
+                     : 1;
+    } else {
+        main_loop(options, std::move(loading), window);
+    }
 
     std::cout << "Shutting down\n";
     glfwDestroyWindow(window);
     glfwTerminate();
 
-    return 0;
+    return status;
 }
@@ -0,0 +1,60 @@
+#version 320 es
+
+precision highp float;
+precision highp int;
+precision highp sampler2D;
+precision highp sampler2DArray;
+
+in vec2 texcoord;
+in vec2 cell_pos;
+flat in int layer;
+
+const int MAX_LAYERS = 8;
+
+uniform sampler2DArray images;
+uniform vec2 layer_sizes[MAX_LAYERS];
+uniform int g_filter_type;
+uniform bool difference;
+uniform float difference_gain;
+
+out vec3 out_color;
+
+#include "filter.glsl"
+
+int current_layer;
+
+vec3 fetch_texel(ivec2 pos) {
+    return texelFetch(images, ivec3(pos, current_layer), 0).xyz;
+}
+
+ivec2 get_texture_size() {
+    return ivec2(layer_sizes[current_layer]);
+}
+
+// Black, blue, red, yellow, white for increasing differences
+vec3 heatmap(float value) {
+    vec3 colors[5] = vec3[](vec3(0.0), vec3(0.0, 0.0, 1.0),
+                            vec3(1.0, 0.0, 0.0), vec3(1.0, 1.0, 0.0),
+                            vec3(1.0));
+    float pos = clamp(value, 0.0, 1.0) * 4.0;
+    int index = min(int(pos), 3);
+    return mix(colors[index], colors[index + 1], pos - float(index));
+}
+
+void main()
+{
+    // Clip each image to its own cell
+    if (abs(cell_pos.x) > 1.0 || abs(cell_pos.y) > 1.0) {
+        discard;
+    }
+    current_layer = layer;
+    vec3 color = apply_filter(g_filter_type, texcoord);
+    if (difference && layer != 0) {
+        // Compare with the first image at the same image position
+        current_layer = 0;
+        vec2 offset = (layer_sizes[0] - layer_sizes[layer]) / 2.0;
+        vec3 reference = apply_filter(g_filter_type, texcoord + offset);
+        color = heatmap(length(color - reference) * difference_gain);
+    }
+    out_color = color;
+}
@@ -0,0 +1,35 @@
+#version 320 es
+
+out highp vec4 gl_Position;
+out highp vec2 texcoord;
+out highp vec2 cell_pos;
+flat out int layer;
+
+in highp vec2 in_position;
+in highp vec2 in_texcoord;
+
+const int MAX_LAYERS = 8;
+
+uniform highp mat4 transform_pos;
+uniform highp vec2 image_size;
+uniform highp vec2 layer_sizes[MAX_LAYERS];
+uniform ivec2 grid;
+uniform int first_layer;
+// Part of the window being drawn (the identity, except for exports)
+uniform highp mat4 output_transform;
+
+// One instance per image, each drawn into its own cell of the grid
+void main()
+{
+    layer = first_layer + gl_InstanceID;
+    vec2 size = layer_sizes[layer];
+    vec4 pos = transform_pos * vec4(in_position * size / image_size, 0.0f, 1.0f);
+    cell_pos = pos.xy;
+
+    ivec2 cell = ivec2(gl_InstanceID % grid.x, gl_InstanceID / grid.x);
+    vec2 cell_center = vec2(-1.0 + (2.0 * float(cell.x) + 1.0) / float(grid.x),
+                            1.0 - (2.0 * float(cell.y) + 1.0) / float(grid.y));
+    gl_Position = output_transform *
+        vec4(cell_center + pos.xy / vec2(grid), 0.0f, 1.0f);
+    texcoord = in_texcoord * size - vec2(0.5, 0.5);
+}
@@ -0,0 +1,28 @@
+#version 320 es
+
+precision highp float;
+precision highp int;
+precision highp sampler2DArray;
+
+in vec2 texcoord;
+flat in vec2 thumbnail_size;
+flat in int layer;
+
+uniform sampler2DArray thumbnails;
+
+out vec3 out_color;
+
+const vec3 SELECTION_COLOR = vec3(0.9, 0.6, 0.1);
+const vec3 PLACEHOLDER_COLOR = vec3(0.25);
+
+void main()
+{
+    if (any(lessThan(texcoord, vec2(0.0))) ||
+        any(greaterThanEqual(texcoord, thumbnail_size))) {
+        out_color = SELECTION_COLOR;
+    } else if (layer < 0) {
+        out_color = PLACEHOLDER_COLOR;
+    } else {
+        out_color = texelFetch(thumbnails, ivec3(texcoord, layer), 0).rgb;
+    }
+}
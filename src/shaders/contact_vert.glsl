@@ -0,0 +1,49 @@
+#version 320 es
+
+out highp vec4 gl_Position;
+out highp vec2 texcoord;
+flat out highp vec2 thumbnail_size;
+flat out highp int layer;
+
+in highp vec2 in_position;
+in highp vec2 in_texcoord;
+
+// Per cell: layer (or -1), thumbnail width and height, and quarter turns
+// (plus 4 if mirrored)
+uniform highp isampler2D cells;
+uniform highp vec2 window_size;
+uniform highp vec2 origin;
+uniform highp float cell_size;
+uniform int columns;
+uniform int selected;
+uniform highp float border;
+
+void main()
+{
+    ivec4 cell = texelFetch(cells, ivec2(gl_InstanceID % 64,
+                                         gl_InstanceID / 64), 0);
+    layer = cell.x;
+    thumbnail_size = vec2(cell.yz);
+    int quarter_turns = cell.w % 4;
+    vec2 size = quarter_turns % 2 == 0 ? thumbnail_size : thumbnail_size.yx;
+    float margin = gl_InstanceID == selected ? border : 0.0;
+
+    // Centered in its cell, on whole pixels (y points down)
+    vec2 cell_pos = vec2(gl_InstanceID % columns, gl_InstanceID / columns);
+    vec2 corner = origin + cell_pos * cell_size +
+        floor((cell_size - size) / 2.0);
+    vec2 square = (in_position * vec2(1.0, -1.0) + 1.0) / 2.0;
+    vec2 pixel = corner - margin + square * (size + 2.0 * margin);
+    gl_Position = vec4(pixel / window_size * vec2(2.0, -2.0) +
+                       vec2(-1.0, 1.0), 0.0, 1.0);
+
+    // Position in the thumbnail as stored: undo the turns, then the mirroring
+    vec2 uv = (in_texcoord * (size + 2.0 * margin) - margin) / size;
+    for (int i = 0; i < quarter_turns; i++) {
+        uv = vec2(uv.y, 1.0 - uv.x);
+    }
+    if (cell.w >= 4) {
+        uv.x = 1.0 - uv.x;
+    }
+    texcoord = uv * thumbnail_size;
+}
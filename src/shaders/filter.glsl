@@ -0,0 +1,140 @@
+// Resampling filters shared by the fragment shaders. The including shader
+// provides the texels through these functions.
+vec3 fetch_texel(ivec2 pos);
+ivec2 get_texture_size();
+
+uniform sampler2D input_lut;
+uniform sampler2D output_lut;
+uniform mat3 gamut_transform;
+uniform float pixel_size;
+uniform bool srgb_enabled;
+uniform float gaussian_a;
+// Half width of the Gaussian in sigmas, and the lobes of Lanczos
+uniform float gaussian_support;
+uniform float lanczos_a;
+uniform bool adjust_enabled;
+uniform float adjust_scale;
+uniform float adjust_offset;
+uniform float adjust_gamma_inv;
+uniform float tone_map_white2;
+
+const float PI = 3.14159265358979;
+const int FILTER_BOX = 1;
+const int FILTER_TENT = 2;
+const int FILTER_GAUSSIAN = 3;
+const int FILTER_LANCZOS = 4;
+// The kernels declared in kernels.txt follow the built-in filters
+const int FILTER_KERNEL = 5;
+
+// Source values to linear light, indexed by 8-bit value
+vec3 decode_color(vec3 c) {
+    if (!srgb_enabled) return c;
+    ivec3 i = ivec3(c * 255.0 + 0.5);
+    return vec3(texelFetch(input_lut, ivec2(i.r, 0), 0).r,
+                texelFetch(input_lut, ivec2(i.g, 0), 0).g,
+                texelFetch(input_lut, ivec2(i.b, 0), 0).b);
+}
+
+// Linear light to display values, with the LUT indexed by sqrt(value)
+vec3 encode_color(vec3 rgb) {
+    if (!srgb_enabled) return rgb;
+    float size = float(textureSize(output_lut, 0).x);
+    vec3 u = sqrt(clamp(gamut_transform * rgb, 0.0, 1.0));
+    vec3 pos = (u * (size - 1.0) + 0.5) / size;
+    return vec3(texture(output_lut, vec2(pos.r, 0.5)).r,
+                texture(output_lut, vec2(pos.g, 0.5)).g,
+                texture(output_lut, vec2(pos.b, 0.5)).b);
+}
+
+// Exposure, levels, tone mapping (extended Reinhard, if white2 > 0) and
+// gamma, in linear light
+vec3 adjust_color(vec3 rgb) {
+    if (!adjust_enabled) return rgb;
+    rgb = max(rgb * adjust_scale - adjust_offset, 0.0);
+    if (tone_map_white2 > 0.0) {
+        rgb = rgb * (1.0 + rgb / tone_map_white2) / (1.0 + rgb);
+    }
+    return pow(rgb, vec3(adjust_gamma_inv));
+}
+
+// Note: not normalized
+float gauss(float x, float a) {
+    return exp(-a * x * x);
+}
+
+float sinc(float x) {
+    if (abs(x) < 0.00001) return 1.0;
+    return sin(PI * x) / (PI * x);
+}
+
+float lanczos(float x, float a) {
+    return sinc(x) * sinc(x / a);
+}
+
+float tent(float x) {
+    return 1.0 - abs(x);
+}
+
+#include "kernels.glsl"
+
+float filter_width(int filter_type) {
+    if (filter_type == FILTER_TENT) {
+        return 1.0;
+    } else if (filter_type == FILTER_GAUSSIAN) {
+        float sigma = 1.0 / sqrt(2.0 * gaussian_a);
+        return sigma * gaussian_support;
+    } else if (filter_type == FILTER_LANCZOS) {
+        return lanczos_a;
+    } else if (filter_type == FILTER_BOX) {
+        return 0.5;
+    } else if (filter_type >= FILTER_KERNEL) {
+        return kernel_width(filter_type - FILTER_KERNEL);
+    }
+}
+
+float filter_weight(int filter_type, float x) {
+    if (filter_type == FILTER_TENT) {
+        return tent(x);
+    } else if (filter_type == FILTER_GAUSSIAN) {
+        return gauss(x, gaussian_a);
+    } else if (filter_type == FILTER_LANCZOS) {
+        return lanczos(x, lanczos_a);
+    } else if (filter_type == FILTER_BOX) {
+        return 1.0;
+    } else if (filter_type >= FILTER_KERNEL) {
+        return kernel_weight(filter_type - FILTER_KERNEL, x);
+    }
+}
+
+// Wrap around mirrored (back and forth)
+int wrap_single(int x, int limit) {
+    float fx = float(x);
+    float flimit = float(limit);
+    return int(round(flimit - abs(flimit - (mod(abs(fx), 2.0*flimit)))));
+}
+
+ivec2 wrap_mirrored(ivec2 x, ivec2 size) {
+    return ivec2(wrap_single(x.x, size.x), wrap_single(x.y, size.y));
+}
+
+vec3 apply_filter(int filter_type, vec2 texcoord) {
+    vec3 color = vec3(0.0);
+    float total_weight = 0.0;
+    float scale = pixel_size;
+    ivec2 texsize = get_texture_size();
+    float width = scale * filter_width(filter_type);
+    ivec2 start = ivec2(ceil(texcoord.x - width), ceil(texcoord.y - width));
+    ivec2 end = ivec2(floor(texcoord.x + width), floor(texcoord.y + width));
+    for (int y = start.y; y <= end.y; y++) {
+        for (int x = start.x; x <= end.x; x++) {
+            vec2 delta = (vec2(x, y) - texcoord) / scale;
+            float weight = filter_weight(filter_type, delta.x) *
+                filter_weight(filter_type, delta.y);
+            ivec2 pos = wrap_mirrored(ivec2(x, y), texsize - ivec2(1, 1));
+            vec3 c = fetch_texel(pos);
+            color += decode_color(c) * weight;
+            total_weight += weight;
+        }
+    }
+    return encode_color(adjust_color(color / total_weight));
+}
@@ -0,0 +1,22 @@
+#version 320 es
+
+precision highp float;
+precision highp int;
+precision highp sampler2D;
+
+in vec2 texcoord;
+
+// Bar heights (0 - 1) of the red, green and blue histograms
+uniform sampler2D histogram;
+
+out vec4 out_color;
+
+void main()
+{
+    int bin = min(int(texcoord.x * 256.0), 255);
+    vec3 heights = texelFetch(histogram, ivec2(bin, 0), 0).rgb;
+    // Overlapping bars add up to yellow, cyan, magenta or white
+    vec3 bars = vec3(greaterThan(heights, vec3(1.0 - texcoord.y)));
+    out_color = any(greaterThan(bars, vec3(0.0))) ? vec4(bars, 0.9)
+                                                  : vec4(vec3(0.0), 0.6);
+}
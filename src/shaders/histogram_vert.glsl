@@ -0,0 +1,18 @@
+#version 320 es
+
+out highp vec4 gl_Position;
+out highp vec2 texcoord;
+
+in highp vec2 in_position;
+in highp vec2 in_texcoord;
+
+// Corners of the overlay in normalized device coordinates
+uniform highp vec2 rect_min;
+uniform highp vec2 rect_max;
+
+void main()
+{
+    vec2 pos = mix(rect_min, rect_max, (in_position + 1.0) / 2.0);
+    gl_Position = vec4(pos, 0.0f, 1.0f);
+    texcoord = in_texcoord;
+}